@@ -1,27 +1,97 @@
 #include <utility>
 
 #include "big_integer.h"
+#include "bigint_kernels.h"
 #include <iostream>
 #include <cstdlib>
 #include <limits>
 #include <algorithm>
 #include <string>
 #include <cmath>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
 
 const bool PLUS = false;
 
-const size_t SIZE = 9;
-const uint BLOCK = (int)1e9;
+constexpr limb pow10(size_t n) {
+    return n == 0 ? 1 : 10 * pow10(n - 1);
+}
+
+// decimal digits per block, the largest power of ten below the limb base
+const size_t SIZE = std::numeric_limits<limb>::digits10;
+const limb BLOCK = pow10(SIZE);
+const size_t PARSE_THRESHOLD = 64;
+const size_t TO_STRING_THRESHOLD = 64;
+const size_t NEWTON_THRESHOLD = 4000;
+const size_t NEWTON_DIVIDEND_RATIO = 8;
+const size_t NEWTON_BASECASE = 1000;
+
+const size_t SIZEOF_INT = static_cast<const size_t>(std::numeric_limits<limb>::digits);
+//________________________________________________________
+
+namespace {
+
+// BLOCK^(2^k), shared by the divide-and-conquer conversions. The lock only guards the
+// cache, a missing power is squared outside of it; the deque keeps references to the
+// powers valid while it grows.
+const big_integer& block_power(size_t k) {
+    static std::deque<big_integer> powers(1, big_integer(bigint_vector(1, BLOCK), PLUS));
+    static std::mutex powers_mutex;
+
+    std::unique_lock<std::mutex> lock(powers_mutex);
+    while (powers.size() <= k) {
+        size_t next = powers.size();
+        const big_integer& last = powers.back();
+        lock.unlock();
+        big_integer square = sqr(last);
+        lock.lock();
+        if (powers.size() == next) {
+            powers.push_back(std::move(square));
+        }
+    }
+    return powers[k];
+}
+
+big_integer parse_digits(const char* str, size_t len) {
+    size_t blocks = (len + SIZE - 1) / SIZE;
+    if (blocks > PARSE_THRESHOLD) {
+        size_t k = 0;
+        while ((size_t(2) << k) < blocks) k++;
+        size_t low_len = SIZE << k;
+        if (blocks < kernels::PARALLEL_THRESHOLD) {
+            return parse_digits(str, len - low_len) * block_power(k) + parse_digits(str + len - low_len, low_len);
+        }
+        // computed before the fork, so that the halves only find smaller powers in the cache
+        const big_integer& p = block_power(k);
+        big_integer high, low;
+        bigint_parallel::invoke([&] { high = parse_digits(str, len - low_len); },
+                                [&] { low = parse_digits(str + len - low_len, low_len); });
+        return high * p + low;
+    }
+
+    bigint_vector res(blocks + 1, 0);
+    limb* res_data = res.data();
+    size_t n = 1;
+    for (size_t i = 0, cur_size = (len - 1) % SIZE + 1; i < len; i += cur_size, cur_size = SIZE) {
+        limb value = 0;
+        for (size_t j = i; j < i + cur_size; j++) {
+            value = value * 10 + (str[j] - '0');
+        }
+        limb carry = kernels::mul_1(res_data, res_data, n, pow10(cur_size));
+        carry += kernels::add_1(res_data, res_data, n, value);
+        if (carry) res_data[n++] = carry;
+    }
+    return big_integer(res, PLUS);
+}
 
-const uint ZERO_PLUS = 0;
-const uint ZERO_MINUS = static_cast<const uint>(std::numeric_limits<uint>::max());
+}
 
-const uint MAX = UINT32_MAX;
-const size_t SIZEOF_INT = static_cast<const size_t>(std::numeric_limits<uint>::digits);
 //________________________________________________________
 
 big_integer::big_integer() : digits(1, 0), sign(PLUS) {}
-big_integer::big_integer(int a) : digits(1, a), sign(a < 0) {}
+big_integer::big_integer(int a) : digits(1, a < 0 ? -static_cast<limb>(a) : a), sign(a < 0) {}
 
 big_integer::big_integer(big_integer const& other) {
     digits = other.digits;
@@ -31,21 +101,14 @@ big_integer::big_integer(big_integer const& other) {
 big_integer::big_integer(uint a) : digits(1, a), sign(PLUS) {}
 
 big_integer::big_integer(std::string const& str) : big_integer() {
-    bool this_sign = str[0] == '-';
+    bool this_sign = !str.empty() && str[0] == '-';
     size_t i = (this_sign ? 1 : 0);
-    for (; i < str.size(); i += SIZE) {
-        size_t cur_size = std::min<size_t>(SIZE, str.size() - i);
-        std::string rest = str.substr(i, cur_size);
-        if (i + SIZE > str.size()) {
-            int pow10 = 1;
-            for (size_t p = 0; p < cur_size; p++) pow10 *= 10;
-            *this *= pow10;
-        } else {
-            *this *= BLOCK;
-        }
-        *this += static_cast<uint>(std::stoul(rest));
+    for (size_t j = i; j < str.size(); j++) {
+        if (str[j] < '0' || str[j] > '9') throw std::invalid_argument("Invalid number: " + str);
+    }
+    if (i < str.size()) {
+        *this = parse_digits(str.data() + i, str.size() - i);
     }
-    pop_first_zeros();
     if (this_sign) {
         this->invert_sign();
     }
@@ -63,21 +126,122 @@ big_integer &big_integer::operator=(big_integer const& other) {
     return *this;
 }
 
-big_integer &big_integer::operator=(big_integer &&other) = default;
+// the moved-from value is left as zero
+big_integer::big_integer(big_integer &&other) noexcept : digits(std::move(other.digits)), sign(other.sign) {
+    other.digits.resize(1);
+    other.sign = PLUS;
+}
+
+big_integer &big_integer::operator=(big_integer &&other) noexcept {
+    if (this != &other) {
+        digits = std::move(other.digits);
+        sign = other.sign;
+        other.digits.resize(1);
+        other.sign = PLUS;
+    }
+    return *this;
+}
 
 big_integer::~big_integer() = default;
 
 //________________________________________________________
 
+
+//________________________________________________________
+
+struct operation_and {
+    template <typename T>
+    T operator()(T a, T b) const {
+        return a & b;
+    }
+
+    static void kernel(limb *r, const limb *a, const limb *b, size_t n, limb ma, limb mb, limb mr) {
+        kernels::and_n(r, a, b, n, ma, mb, mr);
+    }
+};
+
+struct operation_or {
+    template <typename T>
+    T operator()(T a, T b) const {
+        return a | b;
+    }
+
+    static void kernel(limb *r, const limb *a, const limb *b, size_t n, limb ma, limb mb, limb mr) {
+        kernels::ior_n(r, a, b, n, ma, mb, mr);
+    }
+};
+
+struct operation_xor {
+    template <typename T>
+    T operator()(T a, T b) const {
+        return a ^ b;
+    }
+
+    static void kernel(limb *r, const limb *a, const limb *b, size_t n, limb ma, limb mb, limb mr) {
+        kernels::xor_n(r, a, b, n, ma, mb, mr);
+    }
+};
+
+// Bitwise operations act on the infinite two's complement form, in which a negative m
+// is ~(m - 1). With m - 1 in place of the magnitude of a negative operand or result
+// the kernel only has to complement it, and the subtraction stops at the lowest nonzero limb.
+template <typename Operation>
+big_integer& bit_operation_generator(big_integer& a, big_integer const& b, Operation operation) {
+    if (&a == &b) {
+        return bit_operation_generator(a, big_integer(b), operation);
+    }
+    size_t bn = b.size(), n = std::max(a.size(), bn) + 1;
+    bool sign = operation(a.sign, b.sign);
+    limb ma = a.sign ? ~limb(0) : 0, mb = b.sign ? ~limb(0) : 0, mr = sign ? ~limb(0) : 0;
+    a.digits.resize(n);
+    limb* r = a.digits.data();
+    const limb* y = b.digits.data();
+    if (a.sign) {
+        kernels::sub_1(r, r, n, 1);
+    }
+    size_t low = 0;
+    if (b.sign) {
+        // the limbs of b - 1 below the lowest nonzero limb of b are all ones
+        for (; y[low] == 0; low++) {
+            r[low] = operation(r[low] ^ ma, limb(0)) ^ mr;
+        }
+        r[low] = operation(r[low] ^ ma, ~(y[low] - 1)) ^ mr;
+        low++;
+    }
+    Operation::kernel(r + low, r + low, y + low, bn - low, ma, mb, mr);
+    // above b the result keeps or complements a, or it is constant
+    limb zero = operation(ma, mb) ^ mr, ones = operation(~ma, mb) ^ mr;
+    if (zero == ones) {
+        std::fill(r + bn, r + n, zero);
+    } else if (zero) {
+        kernels::com_n(r + bn, r + bn, n - bn);
+    }
+    if (sign) {
+        kernels::add_1(r, r, n, 1);
+    }
+    a.sign = sign;
+    a.pop_first_zeros();
+    return a;
+}
+
+//________________________________________________________
+
 big_integer &big_integer::operator+=(big_integer const& rhs) {
-    *this = *this + rhs;
+    add_in_place(rhs, false);
     return *this;
 }
 big_integer &big_integer::operator-=(big_integer const& rhs) {
-    *this = *this - rhs;
+    add_in_place(rhs, true);
     return *this;
 }
 big_integer &big_integer::operator*=(big_integer const& rhs) {
+    // a multiplier of a single limb is applied to the magnitude in place
+    if (rhs.size() == 1) {
+        bool rhs_sign = rhs.sign;
+        mul_limb(rhs.get_digit(0));
+        if (rhs_sign) invert_sign();
+        return *this;
+    }
     *this = *this * rhs;
     return *this;
 }
@@ -90,253 +254,846 @@ big_integer &big_integer::operator%=(big_integer const& rhs) {
     return *this;
 }
 big_integer &big_integer::operator&=(big_integer const& rhs) {
-    *this = *this & rhs;
-    return *this;
+    return bit_operation_generator(*this, rhs, operation_and());
 }
 big_integer &big_integer::operator|=(big_integer const& rhs) {
-    *this = *this | rhs;
-    return *this;
+    return bit_operation_generator(*this, rhs, operation_or());
 }
 big_integer &big_integer::operator^=(big_integer const& rhs) {
-    *this = *this ^ rhs;
-    return *this;
+    return bit_operation_generator(*this, rhs, operation_xor());
 }
 big_integer &big_integer::operator<<=(int rhs) {
-    *this = *this << rhs;
+    if (rhs < 0) return *this >>= -rhs;
+    if (is_zero()) return *this;
+    size_t cnt = rhs / SIZEOF_INT;
+    unsigned bits = rhs % SIZEOF_INT;
+    if (bits) {
+        // a single pass moves the limbs up and shifts the bits
+        size_t n = size();
+        digits.resize(n + cnt + 1);
+        limb* data = digits.data();
+        data[n + cnt] = kernels::lshift(data + cnt, data, n, bits);
+        std::fill(data, data + cnt, 0);
+        pop_first_zeros();
+    } else if (cnt) {
+        shift(static_cast<int>(cnt));
+    }
     return *this;
 }
+// rounds toward minus infinity like the shift of a two's complement number, so the
+// magnitude of a negative value is rounded up when any bit set is shifted out
 big_integer &big_integer::operator>>=(int rhs) {
-    *this = *this >> rhs;
+    if (rhs < 0) return *this <<= -rhs;
+    size_t cnt = rhs / SIZEOF_INT;
+    unsigned bits = rhs % SIZEOF_INT;
+    bool round_up = false;
+    if (sign) {
+        for (size_t i = 0; i < std::min(cnt, size()) && !round_up; i++) {
+            round_up = get_digit(i) != 0;
+        }
+        if (cnt < size() && bits) {
+            round_up = round_up || (get_digit(cnt) & ((limb(1) << bits) - 1)) != 0;
+        }
+    }
+    if (cnt >= size()) return *this = (round_up ? -1 : 0);
+
+    if (bits) {
+        limb* data = digits.data();
+        kernels::rshift(data, data + cnt, size() - cnt, bits);
+        digits.resize(size() - cnt);
+    } else if (cnt) {
+        shift(-static_cast<int>(cnt));
+    }
+    limb* data = digits.data();
+    if (round_up && kernels::add_1(data, data, size(), 1)) {
+        digits.push_back(1);
+    }
+    pop_first_zeros();
     return *this;
 }
 //________________________________________________________
 
 big_integer big_integer::operator-() const {
-    return ~*this + 1;
+    big_integer res = *this;
+    res.invert_sign();
+    return res;
 }
 big_integer big_integer::operator+() const {
     return *this;
 }
+// ~a == -a - 1
 big_integer big_integer::operator~() const {
-    bigint_vector ans(digits.size());
-    uint* ans_data = ans.data();
-    const uint* digits_data = digits.data();
-    for (size_t i = 0; i < digits.size(); i++) {
-        ans_data[i] = ~digits_data[i];
-    }
-    return big_integer(ans, !sign);
+    big_integer res = *this;
+    ++res;
+    res.invert_sign();
+    return res;
 }
 //________________________________________________________
 
 big_integer &big_integer::operator++() {
-    *this += 1;
+    add_in_place(1, false);
     return *this;
 }
 const big_integer big_integer::operator++(int a) {
-    *this += 1;
-    return *this;
+    big_integer old = *this;
+    ++*this;
+    return old;
 }
 big_integer &big_integer::operator--() {
-    *this -= 1;
+    add_in_place(1, true);
     return *this;
 }
 const big_integer big_integer::operator--(int a) {
-    *this -= 1;
-    return *this;
+    big_integer old = *this;
+    --*this;
+    return old;
+}
+
+// *this += rhs or *this -= rhs. The magnitude is updated in place, it grows only when
+// rhs is longer or the sum carries out, and the carry propagation stops as soon as
+// the carry does.
+void big_integer::add_in_place(big_integer const& rhs, bool subtract) {
+    if (this == &rhs) {
+        add_in_place(big_integer(rhs), subtract);
+        return;
+    }
+    bool rhs_sign = rhs.sign ^ subtract;
+    size_t an = size(), bn = rhs.size();
+    const limb* b = rhs.digits.data();
+
+    if (sign == rhs_sign) {
+        if (an < bn) digits.resize(bn);
+        limb* a = digits.data();
+        limb carry = kernels::add(a, a, std::max(an, bn), b, bn);
+        if (carry) digits.push_back(carry);
+        return;
+    }
+
+    if (cmp_abs(rhs) >= 0) {
+        limb* a = digits.data();
+        kernels::sub(a, a, an, b, bn);
+    } else {
+        digits.resize(bn);
+        limb* a = digits.data();
+        limb borrow = kernels::sub_n(a, b, a, an);
+        kernels::sub_1(a + an, b + an, bn - an, borrow);
+        sign = rhs_sign;
+    }
+    pop_first_zeros();
+}
+
+// |*this| *= m
+void big_integer::mul_limb(limb m) {
+    limb* data = digits.data();
+    limb carry = kernels::mul_1(data, data, size(), m);
+    if (carry) {
+        digits.push_back(carry);
+    }
+    pop_first_zeros();
 }
 //________________________________________________________
 
 big_integer operator+(const big_integer& a, big_integer const& b) {
-    ull carry = 0;
-    size_t length = std::max(a.size(), b.size()) + 1;
+    big_integer res = a;
+    res += b;
+    return res;
+}
 
-    bigint_vector ans(length + 1);
+big_integer operator-(big_integer const& a, big_integer const& b) {
+    big_integer res = a;
+    res -= b;
+    return res;
+}
 
-    const uint* a_data = a.digits.data();
-    const uint* b_data = b.digits.data();
-    uint* ans_data = ans.data();
+big_integer operator+(big_integer&& a, big_integer const& b) {
+    a += b;
+    return std::move(a);
+}
+big_integer operator+(big_integer const& a, big_integer&& b) {
+    b += a;
+    return std::move(b);
+}
+big_integer operator+(big_integer&& a, big_integer&& b) {
+    a += b;
+    return std::move(a);
+}
+big_integer operator-(big_integer&& a, big_integer const& b) {
+    a -= b;
+    return std::move(a);
+}
+big_integer operator-(big_integer const& a, big_integer&& b) {
+    b -= a;
+    b.invert_sign();
+    return std::move(b);
+}
+big_integer operator-(big_integer&& a, big_integer&& b) {
+    a -= b;
+    return std::move(a);
+}
 
-    uint a_max = a.sign ? MAX : 0;
-    uint b_max = b.sign ? MAX : 0;
+// copies of one value share their limbs, the kernels square those as they do a * a
+big_integer operator*(const big_integer& a, big_integer const& b) {
+    bigint_vector ans(a.size() + b.size());
+    kernels::mul(ans.data(), a.digits.data(), a.size(), b.digits.data(), b.size());
+    return big_integer(ans, a.sign ^ b.sign);
+}
 
-    for (size_t i = 0; i <= length; i++) {
-        ull new_carry = carry + (i < a.size() ? a_data[i] : a_max) + (i < b.size() ? b_data[i] : b_max);
-        carry = new_carry > MAX;
-        ans_data[i] = static_cast<uint>(new_carry);
+// *this += a * b or -= a * b: the product is accumulated into the limbs of *this, and
+// when it outweighs a magnitude of the opposite sign the wrapped difference is negated
+void big_integer::add_product(big_integer const& a, big_integer const& b, bool subtract) {
+    if (a.is_zero() || b.is_zero()) {
+        return;
+    }
+    if (this == &a || this == &b) {
+        add_in_place(a * b, subtract);
+        return;
+    }
+    bool product_sign = a.sign ^ b.sign ^ subtract;
+    if (is_zero()) {
+        sign = product_sign;
     }
+    size_t n = std::max(size(), a.size() + b.size()) + 1;
+    digits.resize(n);
+    limb* r = digits.data();
+    if (sign == product_sign) {
+        kernels::addmul(r, n, a.digits.data(), a.size(), b.digits.data(), b.size());
+    } else if (kernels::submul(r, n, a.digits.data(), a.size(), b.digits.data(), b.size())) {
+        kernels::com_n(r, r, n);
+        kernels::add_1(r, r, n, 1);
+        sign = product_sign;
+    }
+    pop_first_zeros();
+}
 
-    bool sign = (ans_data[length] >> 31) > 0;
-    return big_integer(ans, sign);
+void addmul(big_integer& r, big_integer const& a, big_integer const& b) {
+    r.add_product(a, b, false);
 }
 
-big_integer operator-(big_integer const& a, big_integer const& b) {
-    return a + (-b);
+void submul(big_integer& r, big_integer const& a, big_integer const& b) {
+    r.add_product(a, b, true);
 }
 
-big_integer operator*(const big_integer& a, big_integer const& b) {
-    bigint_vector ans(a.size() + b.size());
-    big_integer positive_a = a.abs();
-    big_integer positive_b = b.abs();
-
-    const uint* positive_a_data = positive_a.digits.data();
-    const uint* positive_b_data = positive_b.digits.data();
-    uint* ans_data = ans.data();
-
-    for (size_t i = 0; i < a.size(); i++) {
-        ull carry = 0;
-        for (size_t j = 0; j < b.size(); j++) {
-            size_t ind = i + j;
-            carry += static_cast<ull>(ans_data[ind]) +
-                     static_cast<ull>(positive_a_data[i]) * static_cast<ull>(positive_b_data[j]);
-            ans_data[ind] = static_cast<uint>(carry & MAX);
-            carry >>= 32;
+big_integer sqr(big_integer const& a) {
+    bigint_vector ans(2 * a.size());
+    kernels::sqr(ans.data(), a.digits.data(), a.size());
+    return big_integer(ans, PLUS);
+}
+
+// Left-to-right binary exponentiation of the odd part of |base|, alternating between two
+// buffers sized for the result up front. The powers of two come back as a single shift.
+big_integer pow(big_integer const& base, uint64_t exp) {
+    if (exp == 0) return 1;
+    if (base.is_zero()) return big_integer();
+
+    size_t zeros = 0;
+    while (base.get_digit(zeros) == 0) zeros++;
+    zeros = zeros * SIZEOF_INT + kernels::ctz(base.get_digit(zeros));
+    const big_integer odd = base.abs() >> static_cast<int>(zeros);
+    size_t bits = odd.bit_length();
+    if (exp > std::numeric_limits<size_t>::max() / bits
+        || (zeros > 0 && exp > static_cast<uint64_t>(std::numeric_limits<int>::max()) / zeros)) {
+        throw std::length_error("Power too large");
+    }
+
+    big_integer result = odd;
+    if (bits > 1) {
+        size_t n = (bits * exp + SIZEOF_INT - 1) / SIZEOF_INT + 1;
+        bigint_vector x(n), t(n);
+        limb* xd = x.data();
+        limb* td = t.data();
+        const limb* bd = odd.digits.data();
+        size_t bn = odd.size(), xn = bn;
+        std::copy(bd, bd + bn, xd);
+        for (int bit = 63 - kernels::clz(exp); bit-- > 0;) {
+            kernels::sqr(td, xd, xn);
+            xn *= 2;
+            while (td[xn - 1] == 0) xn--;
+            std::swap(xd, td);
+            if ((exp >> bit) & 1) {
+                kernels::mul(td, xd, xn, bd, bn);
+                xn += bn;
+                while (td[xn - 1] == 0) xn--;
+                std::swap(xd, td);
+            }
         }
-        ans[i + b.size()] += static_cast<uint>(carry);
-     }
-    big_integer ret(ans, PLUS);
-    return (a.sign ^ b.sign ? -ret : ret);
+        bigint_vector& digits = xd == x.data() ? x : t;
+        digits.resize(xn);
+        result = big_integer(digits, PLUS);
+    }
+    result <<= static_cast<int>(zeros * exp);
+    if (base.sign && (exp & 1)) result.invert_sign();
+    return result;
+}
+
+std::pair<big_integer, big_integer> divmod(big_integer const& a, big_integer const& b) {
+    if (b.is_zero()) throw std::runtime_error("Division by zero");
+    if (a.cmp_abs(b) < 0) return std::make_pair(big_integer(), a);
+
+    if (b.size() >= NEWTON_THRESHOLD && a.size() >= NEWTON_DIVIDEND_RATIO * b.size()) {
+        return reciprocal(b).divmod(a);
+    }
+
+    bigint_vector quotient(a.size() - b.size() + 1);
+    bigint_vector remainder(b.size());
+    kernels::divrem(quotient.data(), remainder.data(), a.digits.data(), a.size(), b.digits.data(), b.size());
+    return std::make_pair(big_integer(quotient, a.sign ^ b.sign), big_integer(remainder, a.sign));
+}
+
+big_integer operator*(big_integer&& a, big_integer const& b) {
+    a *= b;
+    return std::move(a);
+}
+big_integer operator*(big_integer const& a, big_integer&& b) {
+    b *= a;
+    return std::move(b);
+}
+big_integer operator*(big_integer&& a, big_integer&& b) {
+    a *= b;
+    return std::move(a);
 }
 
 big_integer operator/(const big_integer& a, big_integer const& b) {
-    if (b == 0) throw std::runtime_error("Division by zero");
-    big_integer positive_a = a.abs();
-    big_integer positive_b = b.abs();
-    if (positive_a < positive_b) return 0;
+    return divmod(a, b).first;
+}
+
+big_integer operator%(const big_integer& a, big_integer const& b) {
+    return divmod(a, b).second;
+}
+
+//________________________________________________________
+
+reciprocal::reciprocal(big_integer const& divisor) : sign(divisor.sign) {
+    if (divisor.is_zero()) throw std::runtime_error("Division by zero");
+    big_integer positive = divisor.abs();
+    size_t n = positive.size() * SIZEOF_INT;
+    shift = static_cast<int>(n - positive.bit_length());
+    this->divisor = positive << shift;
+    inverse = newton_inverse(this->divisor, n);
+}
+
+// floor(2^2n / d) for d of exactly n bits: the reciprocal of the top half of d
+// is refined by one Newton step and then corrected to the exact value.
+big_integer reciprocal::newton_inverse(big_integer const& d, size_t n) {
+    big_integer power = big_integer(1) << static_cast<int>(2 * n);
+    if (n <= NEWTON_BASECASE * SIZEOF_INT) {
+        return ::divmod(power, d).first;
+    }
+
+    size_t h = n / 2 + SIZEOF_INT;
+    big_integer x = newton_inverse(d >> static_cast<int>(n - h), h) << static_cast<int>(n - h);
+    x += (x * (power - d * x)) >> static_cast<int>(2 * n);
+
+    big_integer r = power - d * x;
+    while (r < 0) {
+        x -= 1;
+        r += d;
+    }
+    while (r >= d) {
+        x += 1;
+        r -= d;
+    }
+    return x;
+}
+
+// The dividend is consumed in blocks of as many limbs as the divisor has; every step
+// divides a number below d * 2^n, whose quotient is estimated from its top n bits
+// and then off by at most 4.
+std::pair<big_integer, big_integer> reciprocal::divmod(big_integer const& a) const {
+    const big_integer positive_a = a.abs() << shift;
+    size_t dn = divisor.size();
+    int n = static_cast<int>(dn * SIZEOF_INT);
+    size_t blocks = (positive_a.size() + dn - 1) / dn;
+
+    bigint_vector quotient(blocks * dn, 0);
+    limb* quotient_data = quotient.data();
+    const limb* a_data = positive_a.digits.data();
+    big_integer r;
+    for (size_t i = blocks; i > 0; i--) {
+        size_t from = (i - 1) * dn, to = std::min(i * dn, positive_a.size());
+        bigint_vector block(to - from);
+        std::copy(a_data + from, a_data + to, block.data());
+
+        big_integer cur = (r << n) + big_integer(block, PLUS);
+        big_integer q = ((cur >> n) * inverse) >> n;
+        r = cur - q * divisor;
+        while (r >= divisor) {
+            r -= divisor;
+            q += 1;
+        }
+        const limb* q_data = q.digits.data();
+        std::copy(q_data, q_data + q.size(), quotient_data + from);
+    }
+
+    big_integer q(quotient, PLUS);
+    r >>= shift;
+    return std::make_pair(a.sign ^ sign ? -q : q, a.sign ? -r : r);
+}
+
+big_integer reciprocal::quotient(big_integer const& a) const {
+    return divmod(a).first;
+}
+
+big_integer reciprocal::remainder(big_integer const& a) const {
+    return divmod(a).second;
+}
+
+//________________________________________________________
 
-    if (positive_b.digits.back() < MAX / 2) {
-        positive_a = positive_a * (MAX / (positive_b.digits.back() + 1));
-        positive_b = positive_b * (MAX / (positive_b.digits.back() + 1));
+big_integer gcd(big_integer const& a, big_integer const& b) {
+    if (a.is_zero()) return b.abs();
+    if (b.is_zero()) return a.abs();
+    bigint_vector g(std::min(a.size(), b.size()) + 1);
+    kernels::gcd(g.data(), a.digits.data(), a.size(), b.digits.data(), b.size());
+    return big_integer(g, PLUS);
+}
+
+big_integer lcm(big_integer const& a, big_integer const& b) {
+    if (a == 0 || b == 0) return big_integer();
+    big_integer result = a / gcd(a, b) * b;
+    return result < 0 ? -result : result;
+}
+
+std::tuple<big_integer, big_integer, big_integer> ext_gcd(big_integer const& a, big_integer const& b) {
+    if (b.is_zero()) return std::make_tuple(a.abs(), big_integer(a.sign ? -1 : a.is_zero() ? 0 : 1), big_integer());
+    if (a.is_zero()) return std::make_tuple(b.abs(), big_integer(), big_integer(b.sign ? -1 : 1));
+
+    // the cofactor of the larger operand comes from the kernel, the other one by division
+    bool swapped = a.cmp_abs(b) < 0;
+    big_integer const& u = swapped ? b : a;
+    big_integer const& v = swapped ? a : b;
+    bigint_vector g(v.size()), s(v.size());
+    size_t sn;
+    bool s_negative;
+    kernels::gcdext(g.data(), s.data(), sn, s_negative, u.digits.data(), u.size(), v.digits.data(), v.size());
+    big_integer d(g, PLUS);
+    big_integer x(s, s_negative ^ u.sign);
+    big_integer y = (d - u * x) / v;
+    return swapped ? std::make_tuple(d, y, x) : std::make_tuple(d, x, y);
+}
+
+big_integer mod_inverse(big_integer const& a, big_integer const& m) {
+    if (m == 0) throw std::runtime_error("Division by zero");
+    big_integer modulus = m < 0 ? -m : m;
+    big_integer d, x;
+    std::tie(d, x, std::ignore) = ext_gcd(a % modulus, modulus);
+    if (d != 1) throw std::invalid_argument("No modular inverse");
+    x %= modulus;
+    return x < 0 ? x + modulus : x;
+}
+
+//________________________________________________________
+
+// The root of the top k * s bits, plus one and shifted back by s bits, bounds the root from
+// above with half of its bits right, and Newton's steps from above decrease until they reach
+// its floor: every level costs a few divisions at twice the precision of the one below.
+big_integer iroot(big_integer const& a, unsigned k) {
+    if (k == 0) throw std::invalid_argument("Zeroth root");
+    if (a.sign) {
+        if (k % 2 == 0) throw std::invalid_argument("Even root of a negative number");
+        return -iroot(-a, k);
+    }
+    if (k == 1 || a.is_zero()) return a;
+
+    size_t bits = a.bit_length();
+    big_integer x;
+    if (bits <= 2 * k * SIZEOF_INT) {
+        x = big_integer(1) << static_cast<int>((bits + k - 1) / k);
+    } else {
+        size_t s = bits / (2 * k);
+        x = (iroot(a >> static_cast<int>(k * s), k) + 1) << static_cast<int>(s);
+    }
+    while (true) {
+        big_integer y = (x * (k - 1) + a / pow(x, k - 1)) / k;
+        if (y >= x) return x;
+        x = std::move(y);
     }
+}
+
+big_integer isqrt(big_integer const& a) {
+    return iroot(a, 2);
+}
+
+//________________________________________________________
 
-    big_integer res, un;
-    
-    const uint* positive_a_data = positive_a.digits.data();
-    uint divisor = positive_b.digits.back();
+namespace {
 
-    big_integer ans;
-    ans.digits.resize(positive_a.size());
-    uint* ans_data = ans.digits.data();
+// a sieve up to n only pays off for binomials whose smaller k is not far below n
+const unsigned BINOMIAL_SIEVE_RATIO = 32;
 
-    for (size_t i = positive_a.size(), ind = 0; i > 0; i--, ind++) {
-        res = (res << SIZEOF_INT);
-        res.digits[0] |= positive_a_data[i - 1];
+// product of [first, last), both halves of equal count multiplied recursively so that
+// the factors of every multiplication are about the same size
+big_integer product_tree(big_integer* first, big_integer* last) {
+    size_t n = last - first;
+    if (n == 0) return 1;
+    if (n == 1) return std::move(*first);
+    big_integer* mid = first + n / 2;
+    return product_tree(first, mid) * product_tree(mid, last);
+}
+
+// small factors are packed as many to a limb as fit before they enter the tree
+big_integer limb_product(std::vector<limb> const& factors) {
+    std::vector<big_integer> leaves;
+    limb acc = 1;
+    for (limb f : factors) {
+        double_limb p = static_cast<double_limb>(acc) * f;
+        if (p >> SIZEOF_INT) {
+            leaves.push_back(big_integer(bigint_vector(1, acc), PLUS));
+            acc = f;
+        } else {
+            acc = static_cast<limb>(p);
+        }
+    }
+    leaves.push_back(big_integer(bigint_vector(1, acc), PLUS));
+    return product_tree(leaves.data(), leaves.data() + leaves.size());
+}
 
-        if (res.size() < positive_b.size()) {
-            ans_data[ind] = 0;
-            continue;
+std::vector<unsigned> odd_primes(unsigned n) {
+    std::vector<unsigned> primes;
+    // index i stands for 2i + 1
+    std::vector<bool> composite(n / 2 + 1);
+    for (uint64_t i = 1; 2 * i + 1 <= n; i++) {
+        if (composite[i]) continue;
+        uint64_t p = 2 * i + 1;
+        primes.push_back(static_cast<unsigned>(p));
+        for (uint64_t j = p * p / 2; 2 * j + 1 <= n; j += p) {
+            composite[j] = true;
         }
+    }
+    return primes;
+}
 
-        if (res.size() == positive_b.size()) {
-            res.digits.push_back(0);
+// The odd part of n!, as the square of the one of (n / 2)! times the odd part of the swing
+// n! / (n / 2)!^2, whose exponent of a prime p is the number of odd n / p^i.
+big_integer odd_factorial(unsigned n, std::vector<unsigned> const& primes) {
+    if (n < 3) return 1;
+    std::vector<limb> factors;
+    for (size_t i = 0; i < primes.size() && primes[i] <= n; i++) {
+        for (unsigned q = n / primes[i]; q > 0; q /= primes[i]) {
+            if (q & 1) factors.push_back(primes[i]);
         }
+    }
+    return sqr(odd_factorial(n / 2, primes)) * limb_product(factors);
+}
 
-        ull cur = res.digits.back();
-        ull prev = res.get_digit(res.size() - 2);
-        cur = (cur << SIZEOF_INT) | prev;
-        cur /= static_cast<ull>(divisor);
+}
+
+big_integer product(std::vector<big_integer> values) {
+    return product_tree(values.data(), values.data() + values.size());
+}
 
-        un = positive_b * static_cast<uint>(cur > MAX ? MAX : cur);
+// Prime swing: the odd part comes from products of prime powers and the n - popcount(n)
+// factors of two from a single shift.
+big_integer factorial(unsigned n) {
+    unsigned twos = n - __builtin_popcount(n);
+    if (twos > static_cast<unsigned>(std::numeric_limits<int>::max())) {
+        throw std::length_error("Factorial too large");
+    }
+    return odd_factorial(n, odd_primes(n)) << static_cast<int>(twos);
+}
 
-        while (cur > 0 && un > res) {
-            cur--;
-            un -= positive_b;
+// For a small k the product of the top k factors of n! is divided by k!, otherwise the
+// exponent of every prime p is the number of borrows of n - k in base p (Kummer).
+big_integer binomial(unsigned n, unsigned k) {
+    if (k > n) return big_integer();
+    k = std::min(k, n - k);
+    std::vector<limb> factors;
+    if (k <= n / BINOMIAL_SIEVE_RATIO) {
+        for (unsigned i = 0; i < k; i++) {
+            factors.push_back(n - i);
         }
+        return limb_product(factors) / factorial(k);
+    }
+    std::vector<unsigned> primes = odd_primes(n);
+    for (unsigned p : primes) {
+        for (uint64_t q = p; q <= n; q *= p) {
+            if (n / q - k / q - (n - k) / q) factors.push_back(p);
+        }
+    }
+    unsigned twos = __builtin_popcount(k) + __builtin_popcount(n - k) - __builtin_popcount(n);
+    return limb_product(factors) << static_cast<int>(twos);
+}
+
+//________________________________________________________
+
+barrett_reducer::barrett_reducer(big_integer const& m) : mod(m.abs()), n(mod.size()) {
+    if (mod.is_zero()) throw std::runtime_error("Division by zero");
+    big_integer mu = ::divmod(big_integer(1) << static_cast<int>(2 * n * SIZEOF_INT), mod).first;
+    // for m = B^(n-1) it takes n + 2 limbs, one less only costs another subtraction
+    if (mu.size() > n + 1) {
+        mu -= 1;
+    }
+    inverse = bigint_vector(n + 1);
+    std::copy(mu.digits.data(), mu.digits.data() + mu.size(), inverse.data());
+    mod_padded = bigint_vector(n + 1);
+    std::copy(m.digits.data(), m.digits.data() + n, mod_padded.data());
+    // the window of 2n limbs followed by the scratch of barrett_reduce
+    scratch = bigint_vector(2 * n + kernels::barrett_scratch_size(n));
+}
+
+big_integer const& barrett_reducer::modulus() const {
+    return mod;
+}
+
+limb* barrett_reducer::window() {
+    return scratch.data();
+}
+
+void barrett_reducer::reduce_window() {
+    kernels::barrett_reduce(window(), static_cast<bigint_vector const&>(mod_padded).data(),
+                            static_cast<bigint_vector const&>(inverse).data(), n, window() + 2 * n);
+}
 
-        ans_data[ind] = cur;
-        res -= un;
+// w[0, n) = x mod m: the top 2n limbs first, then the rest folded in n limbs at a time
+void barrett_reducer::load(const limb* x, size_t xn) {
+    limb* w = window();
+    size_t pos = xn > 2 * n ? xn - 2 * n : 0;
+    std::copy(x + pos, x + xn, w);
+    std::fill(w + xn - pos, w + 2 * n, 0);
+    reduce_window();
+    while (pos > 0) {
+        size_t len = std::min(n, pos);
+        pos -= len;
+        std::copy_backward(w, w + n, w + len + n);
+        std::copy(x + pos, x + pos + len, w);
+        std::fill(w + len + n, w + 2 * n, 0);
+        reduce_window();
+    }
+}
 
+// out = w[0, n), or m - w[0, n) for the residue of a negative value
+void barrett_reducer::store(big_integer& out, bool negative) {
+    limb* w = window();
+    if (negative && std::any_of(w, w + n, [](limb x) { return x != 0; })) {
+        kernels::sub_n(w, static_cast<bigint_vector const&>(mod_padded).data(), w, n);
     }
-    ans.digits.reverse();
-    ans.pop_first_zeros();
+    out.digits.resize(n);
+    std::copy(w, w + n, out.digits.data());
+    out.sign = PLUS;
+    out.pop_first_zeros();
+}
 
-    if (a.sign ^ b.sign) ans.invert_sign();
-    return ans;
+void barrett_reducer::reduce(big_integer& out, big_integer const& x) {
+    if (!x.sign && x.cmp_abs(mod) < 0) {
+        out = x;
+        return;
+    }
+    load(x.digits.data(), x.size());
+    store(out, x.sign);
 }
 
-big_integer operator%(const big_integer& a, big_integer const& b) {
-    return a - a / b * b;
+void barrett_reducer::mul_mod(big_integer& out, big_integer const& a, big_integer const& b) {
+    if (a.size() > n || b.size() > n) {
+        reduce(out, a * b);
+        return;
+    }
+    limb* w = window();
+    limb* pa = w + 2 * n;
+    limb* pb = pa + n;
+    std::copy(a.digits.data(), a.digits.data() + a.size(), pa);
+    std::fill(pa + a.size(), pa + n, 0);
+    std::copy(b.digits.data(), b.digits.data() + b.size(), pb);
+    std::fill(pb + b.size(), pb + n, 0);
+    kernels::mul_n(w, pa, pb, n, pb + n);
+    reduce_window();
+    store(out, a.sign ^ b.sign);
+}
+
+void barrett_reducer::add_mod(big_integer& out, big_integer const& a, big_integer const& b) {
+    if (a.sign || b.sign || a.cmp_abs(mod) >= 0 || b.cmp_abs(mod) >= 0) {
+        reduce(out, a + b);
+        return;
+    }
+    limb* w = window();
+    const limb* m = static_cast<bigint_vector const&>(mod_padded).data();
+    std::copy(a.digits.data(), a.digits.data() + a.size(), w);
+    std::fill(w + a.size(), w + n + 1, 0);
+    kernels::add(w, w, n + 1, b.digits.data(), b.size());
+    if (w[n] != 0 || kernels::cmp(w, m, n) >= 0) {
+        kernels::sub_n(w, w, m, n);
+    }
+    store(out, false);
+}
+
+big_integer barrett_reducer::reduce(big_integer const& x) {
+    big_integer result;
+    reduce(result, x);
+    return result;
+}
+
+big_integer barrett_reducer::mul_mod(big_integer const& a, big_integer const& b) {
+    big_integer result;
+    mul_mod(result, a, b);
+    return result;
+}
+
+big_integer barrett_reducer::add_mod(big_integer const& a, big_integer const& b) {
+    big_integer result;
+    add_mod(result, a, b);
+    return result;
 }
 
 //________________________________________________________
 
-struct operation_and {
-    template <typename T>
-    T operator()(T a, T b) const {
-        return a & b;
+big_integer_accumulator::big_integer_accumulator() : pending(0) {}
+
+big_integer_accumulator& big_integer_accumulator::operator+=(big_integer const& a) {
+    add(a, false);
+    return *this;
+}
+
+big_integer_accumulator& big_integer_accumulator::operator-=(big_integer const& a) {
+    add(a, true);
+    return *this;
+}
+
+big_integer big_integer_accumulator::value() const {
+    return total(0) - total(1);
+}
+
+void big_integer_accumulator::clear() {
+    for (size_t side = 0; side < 2; side++) {
+        std::fill(sums[side].data(), sums[side].data() + sums[side].size(), 0);
+        std::fill(carries[side].data(), carries[side].data() + carries[side].size(), 0);
     }
-};
+    pending = 0;
+}
 
-struct operation_or {
-    template <typename T>
-    T operator()(T a, T b) const {
-        return a | b;
+void big_integer_accumulator::add(big_integer const& a, bool negative) {
+    if (pending == std::numeric_limits<limb>::max()) {
+        fold(0);
+        fold(1);
+        pending = 0;
     }
-};
+    size_t side = a.sign != negative;
+    size_t n = a.size();
+    // one limb above the operand for its carry
+    if (sums[side].size() <= n) {
+        sums[side].resize(n + 1);
+        carries[side].resize(n + 1);
+    }
+    limb* s = sums[side].data();
+    carries[side].data()[n] += kernels::add_n(s, s, a.digits.data(), n);
+    pending++;
+}
 
-struct operation_xor {
-    template <typename T>
-    T operator()(T a, T b) const {
-        return a ^ b;
+void big_integer_accumulator::fold(size_t side) {
+    size_t n = sums[side].size();
+    limb* s = sums[side].data();
+    limb* c = carries[side].data();
+    limb top = kernels::add_n(s, s, c, n);
+    std::fill(c, c + n, 0);
+    if (top != 0) {
+        sums[side].push_back(top);
+        carries[side].push_back(0);
     }
-};
+}
 
-template <typename Operation>
-big_integer bit_operation_generator(const big_integer& a, big_integer const& b, Operation operation) {
-    size_t length = std::max(a.size(), b.size());
-    bigint_vector ans(length);
-    for (size_t i = 0; i < length; i++) {
-        ans[i] = operation(a.get_digit_or_max(i), b.get_digit_or_max(i));
+big_integer big_integer_accumulator::total(size_t side) const {
+    big_integer r;
+    size_t n = sums[side].size();
+    if (n == 0) {
+        return r;
+    }
+    r.digits.resize(n + 1);
+    limb* d = r.digits.data();
+    d[n] = kernels::add_n(d, sums[side].data(), carries[side].data(), n);
+    r.pop_first_zeros();
+    return r;
+}
+
+//________________________________________________________
+
+big_integer pow_mod(big_integer const& base, big_integer const& exp, big_integer const& mod) {
+    if (mod.is_zero()) throw std::runtime_error("Division by zero");
+    if (exp.sign) throw std::invalid_argument("Negative exponent");
+    big_integer m = mod.abs();
+    big_integer result;
+    if (exp.is_zero()) {
+        result = big_integer(1) % m;
+    } else if (m.get_digit(0) & 1) {
+        bigint_vector ans(m.size());
+        kernels::powm(ans.data(), base.digits.data(), base.size(), exp.digits.data(), exp.size(),
+                      mod.digits.data(), mod.size());
+        result = big_integer(ans, PLUS);
+    } else {
+        // Montgomery reduction needs an odd modulus
+        big_integer b = base.abs() % m;
+        result = b;
+        for (size_t i = exp.bit_length() - 1; i-- > 0;) {
+            result = result * result % m;
+            if ((exp.get_digit(i / SIZEOF_INT) >> (i % SIZEOF_INT)) & 1) {
+                result = result * b % m;
+            }
+        }
+    }
+    // (-b)^e = -(b^e) for odd e
+    if (base.sign && (exp.get_digit(0) & 1) && !result.is_zero()) {
+        result = m - result;
     }
-    return big_integer(ans, operation(a.sign, b.sign));
+    return result;
 }
+
+//________________________________________________________
+
 big_integer operator&(const big_integer& a, big_integer const& b) {
-    return bit_operation_generator(a, b, operation_and());
+    big_integer res = a;
+    res &= b;
+    return res;
+}
+big_integer operator&(big_integer&& a, big_integer const& b) {
+    a &= b;
+    return std::move(a);
+}
+big_integer operator&(big_integer const& a, big_integer&& b) {
+    b &= a;
+    return std::move(b);
+}
+big_integer operator&(big_integer&& a, big_integer&& b) {
+    a &= b;
+    return std::move(a);
 }
 big_integer operator|(const big_integer& a, big_integer const& b) {
-    return bit_operation_generator(a, b, operation_or());
+    big_integer res = a;
+    res |= b;
+    return res;
+}
+big_integer operator|(big_integer&& a, big_integer const& b) {
+    a |= b;
+    return std::move(a);
+}
+big_integer operator|(big_integer const& a, big_integer&& b) {
+    b |= a;
+    return std::move(b);
+}
+big_integer operator|(big_integer&& a, big_integer&& b) {
+    a |= b;
+    return std::move(a);
 }
 big_integer operator^(const big_integer& a, big_integer const& b) {
-    return bit_operation_generator(a, b, operation_xor());
+    big_integer res = a;
+    res ^= b;
+    return res;
+}
+big_integer operator^(big_integer&& a, big_integer const& b) {
+    a ^= b;
+    return std::move(a);
+}
+big_integer operator^(big_integer const& a, big_integer&& b) {
+    b ^= a;
+    return std::move(b);
+}
+big_integer operator^(big_integer&& a, big_integer&& b) {
+    a ^= b;
+    return std::move(a);
 }
 //________________________________________________________
 
 big_integer operator<<(big_integer a, int b) {
-    if (b < 0) return a >> (-b);
-    int cnt = b / 32;
-    if (cnt) a.shift(cnt);
-
-    uint big_shift = b % 32;
-    uint small_shift = 32 - big_shift;
-    if (big_shift) {
-        a.digits.push_back(a.zero());
-        for (size_t i = a.size(); i > 0; i--) {
-            if (i < a.size()) {
-                a.digits[i] += a.get_digit(i - 1) >> small_shift;
-            }
-            a.digits[i - 1] <<= big_shift;
-        }
-    }
-    a.pop_first_zeros();
+    a <<= b;
     return a;
 }
 big_integer operator>>(big_integer a, int b) {
-    if (b < 0) return a << (-b);
-    int cnt = b / 32;
-    if (cnt) a.shift(-cnt);
-
-    uint big_shift = b % 32;
-    uint small_shift = 32 - big_shift;
-    if (big_shift) {
-        uint cur = a.zero();
-        for (size_t i = 0; i < a.size(); i++) {
-            if (i > 0) {
-                a.digits[i - 1] += a.get_digit(i) << small_shift;
-            }
-            a.digits[i] >>= big_shift;
-        }
-        a.digits.back() += cur << small_shift;
-    }
-    a.pop_first_zeros();
+    a >>= b;
     return a;
 }
 
@@ -356,14 +1113,9 @@ bool operator!=(big_integer const& a, big_integer const& b) {
     return !(a == b);
 }
 bool operator<(big_integer const& a, big_integer const& b) {
-    if (a.sign != b.sign) return (a.sign > b.sign);
-    if (a.size() != b.size()) return (a.size() < b.size());
-    for (size_t i = a.size(); i > 0; i--) {
-        if (a.get_digit(i - 1) != b.get_digit(i - 1)) {
-            return a.get_digit(i - 1) < b.get_digit(i - 1);
-        }
-    }
-    return false;
+    if (a.sign != b.sign) return a.sign;
+    int c = a.cmp_abs(b);
+    return a.sign ? c > 0 : c < 0;
 }
 bool operator>(big_integer const& a, big_integer const& b) {
     return b < a;
@@ -377,93 +1129,118 @@ bool operator>=(big_integer const& a, big_integer const& b) {
 
 //________________________________________________________
 big_integer operator|(big_integer const& a, uint b) {
-    auto res = a;
-    res.digits[0] |= b;
-    return res;
+    return big_integer(a) | b;
 }
-
-big_integer operator*(big_integer const& a, uint b) {
-    auto res = a;
+big_integer operator|(big_integer&& a, uint b) {
     if (a.sign) {
-        res = -res;
+        a |= big_integer(b);
+    } else {
+        a.digits[0] |= b;
     }
-    res.digits.push_back(0);
-
-    uint* res_data = res.digits.data();
+    return std::move(a);
+}
 
-    ull cur = 0;
-    for (size_t i = 0; i < res.size(); i++) {
-        cur += (ull)res_data[i] * b;
-        res_data[i] = cur & MAX;
-        cur >>= SIZEOF_INT;
-    }
-    if (a.sign) {
-        res = -res;
-    }
-    res.pop_first_zeros();
-    return res;
+big_integer operator*(big_integer const& a, uint b) {
+    return big_integer(a) * b;
+}
+big_integer operator*(big_integer&& a, uint b) {
+    a.mul_limb(b);
+    return std::move(a);
 }
 
 //________________________________________________________
 
 std::string to_string(big_integer const& a) {
     std::string ans;
-    auto mod = BLOCK;
-    big_integer positive_a = a.abs();
-    while (positive_a != 0) {
-        big_integer digit = positive_a % mod;
-        uint new_digit = digit.get_digit_or_max(0);
-        positive_a /= mod;
-        for (size_t i = 0; i < 9; i++) {
+    if (a.sign) ans += '-';
+    a.abs().to_decimal(ans, 0);
+    if (ans.empty() || ans == "-") return "0";
+    return ans;
+}
+
+void big_integer::to_decimal(std::string& out, size_t width) const {
+    if (size() > TO_STRING_THRESHOLD) {
+        size_t k = 0;
+        // BLOCK^(2^(k+1)) has at most twice the limbs of BLOCK^(2^k), so the power used is
+        // at most half of the value and no larger one is computed
+        while (block_power(k).size() * 4 <= size()) k++;
+        const big_integer& p = block_power(k);
+        std::pair<big_integer, big_integer> qr = divmod(*this, p);
+        const big_integer& q = qr.first;
+        const big_integer& r = qr.second;
+
+        size_t low_width = SIZE << k;
+        if (size() < kernels::PARALLEL_THRESHOLD) {
+            q.to_decimal(out, width > low_width ? width - low_width : 0);
+            r.to_decimal(out, low_width);
+            return;
+        }
+        std::string low;
+        bigint_parallel::invoke([&] { q.to_decimal(out, width > low_width ? width - low_width : 0); },
+                                [&] { r.to_decimal(low, low_width); });
+        out += low;
+        return;
+    }
+
+    bigint_vector rest = digits;
+    limb* rest_data = rest.data();
+    std::string ans;
+    for (size_t n = size(); n > 0;) {
+        limb new_digit = kernels::divrem_1(rest_data, rest_data, n, BLOCK);
+        if (rest_data[n - 1] == 0) n--;
+        for (size_t i = 0; i < SIZE; i++) {
             ans += '0' + new_digit % 10;
             new_digit /= 10;
         }
     }
-
-    if (ans.empty()) return "0";
-    while (ans.size() > 1 && ans.back() == '0') ans.pop_back();
-    if (a.sign) ans += "-";
-    std::reverse(ans.begin(), ans.end());
-    return ans;
+    while (!ans.empty() && ans.back() == '0') ans.pop_back();
+    if (ans.size() < width) ans.append(width - ans.size(), '0');
+    out.append(ans.rbegin(), ans.rend());
 }
 
 //________________________________________________________
 
+// trims the leading zero limbs, zero is never negative
 void big_integer::pop_first_zeros() {
-    while (size() > 1 && digits.back() == zero()) {
+    while (size() > 1 && get_digit(size() - 1) == 0) {
         digits.pop_back();
     }
+    if (is_zero()) {
+        sign = PLUS;
+    }
 }
 
 size_t big_integer::size() const {
     return digits.size();
 }
 
-uint big_integer::zero() const {
-    return (!sign ? ZERO_PLUS : ZERO_MINUS);
+bool big_integer::is_zero() const {
+    return size() == 1 && get_digit(0) == 0;
+}
+
+// compares the magnitudes
+int big_integer::cmp_abs(big_integer const& other) const {
+    if (size() != other.size()) return size() < other.size() ? -1 : 1;
+    return kernels::cmp(digits.data(), other.digits.data(), size());
 }
 
 void big_integer::invert_sign() {
-    sign ^= true;
-    for (size_t i = 0; i < size(); i++) {
-        digits[i] = ~digits[i];
+    if (!is_zero()) {
+        sign = !sign;
     }
-    (*this)++;
-    pop_first_zeros();
 }
 
-uint big_integer::get_digit(size_t i) const {
-    return digits[i];
+size_t big_integer::bit_length() const {
+    limb top = get_digit(size() - 1);
+    return (size() - 1) * SIZEOF_INT + (top ? SIZEOF_INT - kernels::clz(top) : 0);
 }
 
-uint big_integer::get_digit_or_max(size_t i) const {
-    if (i >= digits.size()) {
-        return (sign ? MAX : 0);
-    } else {
-        return digits[i];
-    }
+limb big_integer::get_digit(size_t i) const {
+    return digits[i];
 }
 
 big_integer big_integer::abs() const {
-    return (sign ? -*this : *this);
+    big_integer res = *this;
+    res.sign = PLUS;
+    return res;
 }
@@ -2,13 +2,22 @@
 #define BIG_INTEGER_H
 
 #include "bigint_vector.h"
+#include "bigint_pool.h"
+#include "bigint_threads.h"
 #include <functional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 struct big_integer {
     big_integer();
 
     big_integer(big_integer const &other);
 
+    big_integer(big_integer &&other) noexcept;
+
     big_integer(int a);
 
     explicit big_integer(const bigint_vector& num, bool f);
@@ -21,7 +30,7 @@ struct big_integer {
 
     big_integer &operator=(big_integer const &other);
 
-    big_integer &operator=(big_integer &&other);
+    big_integer &operator=(big_integer &&other) noexcept;
 
     big_integer &operator+=(big_integer const &rhs); //
     big_integer &operator-=(big_integer const &rhs);//
@@ -56,12 +65,24 @@ struct big_integer {
     friend std::string to_string(big_integer const &a);//
     friend big_integer operator+(const big_integer &a, big_integer const &b);
 
+    friend big_integer operator-(const big_integer &a, big_integer &&b);
+
     friend big_integer operator*(const big_integer &a, big_integer const &b);
 
+    friend big_integer sqr(big_integer const &a);
+
+    friend void addmul(big_integer &r, big_integer const &a, big_integer const &b);
+
+    friend void submul(big_integer &r, big_integer const &a, big_integer const &b);
+
+    friend big_integer pow(big_integer const &base, uint64_t exp);
+
     friend big_integer operator/(const big_integer &a, big_integer const &b);
 
+    friend std::pair<big_integer, big_integer> divmod(big_integer const &a, big_integer const &b);
+
     template<typename Operation>
-    friend big_integer bit_operation_generator(const big_integer &a, big_integer const &b, Operation operation);
+    friend big_integer &bit_operation_generator(big_integer &a, big_integer const &b, Operation operation);
 
     friend big_integer operator<<(big_integer a, int b);
 
@@ -71,6 +92,23 @@ struct big_integer {
 
     friend big_integer operator*(const big_integer &a, uint b);
 
+    friend big_integer operator|(big_integer &&a, uint b);
+
+    friend big_integer operator*(big_integer &&a, uint b);
+
+    friend big_integer pow_mod(big_integer const &base, big_integer const &exp, big_integer const &mod);
+
+    friend big_integer gcd(big_integer const &a, big_integer const &b);
+
+    friend std::tuple<big_integer, big_integer, big_integer> ext_gcd(big_integer const &a, big_integer const &b);
+
+    friend big_integer iroot(big_integer const &a, unsigned k);
+
+    friend class reciprocal;
+
+    friend class barrett_reducer;
+
+    friend class big_integer_accumulator;
 
 private:
     bigint_vector digits;
@@ -80,29 +118,212 @@ private:
 
     void pop_first_zeros();
 
-    uint zero() const;
+    bool is_zero() const;
+
+    int cmp_abs(big_integer const &other) const;
 
     void invert_sign();
 
-    big_integer abs() const;
+    void add_in_place(big_integer const &rhs, bool subtract);
+
+    void add_product(big_integer const &a, big_integer const &b, bool subtract);
+
+    void mul_limb(limb m);
 
-    uint get_digit(size_t i) const;
+    big_integer abs() const;
 
-    uint get_digit_or_max(size_t i) const;
+    limb get_digit(size_t i) const;
 
     void shift(int rhs);
+
+    void to_decimal(std::string &out, size_t width) const;
+
+    size_t bit_length() const;
+};
+
+// Precomputed Newton reciprocal of a fixed divisor, so that every division by it
+// costs a few multiplications.
+class reciprocal {
+public:
+    explicit reciprocal(big_integer const &divisor);
+
+    std::pair<big_integer, big_integer> divmod(big_integer const &a) const;
+
+    big_integer quotient(big_integer const &a) const;
+
+    big_integer remainder(big_integer const &a) const;
+
+private:
+    big_integer divisor;
+    bool sign;
+    int shift;
+    big_integer inverse;
+
+    static big_integer newton_inverse(big_integer const &d, size_t n);
+};
+
+// Barrett reduction modulo a fixed m: floor(B^2n / |m|) is computed once, and a value
+// below B^2n is then reduced by two multiplications and at most a few subtractions.
+// Results are in [0, |m|). The overloads taking an output reuse its limbs, so short of
+// the NTT sizes they do not allocate for operands of at most n limbs (and, for add_mod,
+// in [0, |m|)). The exception is a residue of at most BIGINT_INLINE_LIMBS limbs: it moves
+// the output into the inline limbs, and the next longer result allocates again.
+// The reducer keeps its scratch inside and must not be shared between threads.
+class barrett_reducer {
+public:
+    explicit barrett_reducer(big_integer const &mod);
+
+    big_integer const &modulus() const;
+
+    big_integer reduce(big_integer const &x);
+
+    big_integer mul_mod(big_integer const &a, big_integer const &b);
+
+    big_integer add_mod(big_integer const &a, big_integer const &b);
+
+    // out may alias the operands
+    void reduce(big_integer &out, big_integer const &x);
+
+    void mul_mod(big_integer &out, big_integer const &a, big_integer const &b);
+
+    void add_mod(big_integer &out, big_integer const &a, big_integer const &b);
+
+private:
+    big_integer mod;
+    size_t n;
+    bigint_vector mod_padded;
+    bigint_vector inverse;
+    bigint_vector scratch;
+
+    limb *window();
+
+    void reduce_window();
+
+    void load(const limb *x, size_t xn);
+
+    void store(big_integer &out, bool negative);
+};
+
+// Running sum of many values. An addition adds the limbs of its operand into a buffer
+// that only grows, and the carry out of the top limb of the operand is kept in a second
+// number of the same length instead of being propagated (carry-save), so it neither
+// allocates nor normalizes. Negative values go into a buffer of their own; value() folds
+// the carries in and subtracts once.
+class big_integer_accumulator {
+public:
+    big_integer_accumulator();
+
+    big_integer_accumulator &operator+=(big_integer const &a);
+
+    big_integer_accumulator &operator-=(big_integer const &a);
+
+    big_integer value() const;
+
+    void clear();
+
+private:
+    // sums[0] and carries[0] for the positive values, sums[1] and carries[1] for the negative ones
+    bigint_vector sums[2];
+    bigint_vector carries[2];
+    // additions since the carries were last folded, each raises a carry limb by at most one
+    limb pending;
+
+    void add(big_integer const &a, bool negative);
+
+    void fold(size_t side);
+
+    big_integer total(size_t side) const;
 };
 
 big_integer operator+(const big_integer &a, big_integer const &b);//
 big_integer operator-(const big_integer &a, big_integer const &b);//
 big_integer operator*(const big_integer &a, big_integer const &b);//
+
+// The result takes over the storage of a temporary operand.
+big_integer operator+(big_integer &&a, big_integer const &b);
+big_integer operator+(big_integer const &a, big_integer &&b);
+big_integer operator+(big_integer &&a, big_integer &&b);
+big_integer operator-(big_integer &&a, big_integer const &b);
+big_integer operator-(big_integer const &a, big_integer &&b);
+big_integer operator-(big_integer &&a, big_integer &&b);
+big_integer operator*(big_integer &&a, big_integer const &b);
+big_integer operator*(big_integer const &a, big_integer &&b);
+big_integer operator*(big_integer &&a, big_integer &&b);
 big_integer operator/(const big_integer &a, big_integer const &b);
 
 big_integer operator%(const big_integer &a, big_integer const &b);
 
+// quotient rounded toward zero and the remainder with the sign of a
+std::pair<big_integer, big_integer> divmod(big_integer const &a, big_integer const &b);
+
+// a * a with the squaring kernels, which a * b also picks when both sides hold the same limbs
+big_integer sqr(big_integer const &a);
+
+// base^exp, pow(0, 0) = 1
+big_integer pow(big_integer const &base, uint64_t exp);
+
+// r += a * b and r -= a * b without a separate product
+void addmul(big_integer &r, big_integer const &a, big_integer const &b);
+
+void submul(big_integer &r, big_integer const &a, big_integer const &b);
+
+// the sum of the values in [first, last), added with a big_integer_accumulator
+template <typename InputIterator>
+big_integer sum(InputIterator first, InputIterator last) {
+    big_integer_accumulator acc;
+    for (; first != last; ++first) {
+        acc += *first;
+    }
+    return acc.value();
+}
+
+// base^exp mod |mod| in [0, |mod|), exp >= 0
+big_integer pow_mod(big_integer const &base, big_integer const &exp, big_integer const &mod);
+
+// non-negative, gcd(0, 0) = 0
+big_integer gcd(big_integer const &a, big_integer const &b);
+
+// non-negative, zero if either operand is
+big_integer lcm(big_integer const &a, big_integer const &b);
+
+// (g, x, y) with g = gcd(a, b) = a * x + b * y
+std::tuple<big_integer, big_integer, big_integer> ext_gcd(big_integer const &a, big_integer const &b);
+
+// x in [0, |m|) with a * x = 1 mod m
+big_integer mod_inverse(big_integer const &a, big_integer const &m);
+
+// floor of the k-th root, rounded toward zero for a negative a and odd k
+big_integer iroot(big_integer const &a, unsigned k);
+
+// floor of the square root of a >= 0
+big_integer isqrt(big_integer const &a);
+
+// the product of the values, multiplied in a balanced tree, product({}) = 1
+big_integer product(std::vector<big_integer> values);
+
+template <typename InputIterator>
+big_integer product(InputIterator first, InputIterator last) {
+    return product(std::vector<big_integer>(first, last));
+}
+
+// n!
+big_integer factorial(unsigned n);
+
+// n choose k, zero for k > n
+big_integer binomial(unsigned n, unsigned k);
+
 big_integer operator&(const big_integer &a, big_integer const &b);//
 big_integer operator|(const big_integer &a, big_integer const &b);//
 big_integer operator^(const big_integer &a, big_integer const &b);//
+big_integer operator&(big_integer &&a, big_integer const &b);
+big_integer operator&(big_integer const &a, big_integer &&b);
+big_integer operator&(big_integer &&a, big_integer &&b);
+big_integer operator|(big_integer &&a, big_integer const &b);
+big_integer operator|(big_integer const &a, big_integer &&b);
+big_integer operator|(big_integer &&a, big_integer &&b);
+big_integer operator^(big_integer &&a, big_integer const &b);
+big_integer operator^(big_integer const &a, big_integer &&b);
+big_integer operator^(big_integer &&a, big_integer &&b);
 
 big_integer operator<<(big_integer a, int b);//
 big_integer operator>>(big_integer a, int b);//
@@ -117,6 +338,195 @@ bool operator>=(big_integer const &a, big_integer const &b);//
 
 big_integer operator|(const big_integer &a, uint b);
 big_integer operator*(const big_integer &a, uint b);
+big_integer operator|(big_integer &&a, uint b);
+big_integer operator*(big_integer &&a, uint b);
+
+// Opt-in lazy sums of products. lazy(a) * b makes a product that is not computed on its
+// own: combined with + and - into an expression such as lazy(a) * b + c - lazy(d) * e,
+// it is evaluated term by term with addmul and submul, into the destination of += and -=
+// or into a single new value. Products refer to their operands, so an expression has to
+// be evaluated in the statement that builds it; the other terms are held by value.
+namespace bigint_lazy {
+    struct operand {
+        big_integer const &value;
+    };
+
+    struct term {
+        big_integer value;
+        bool negative;
+
+        term operator-() const {
+            return term{value, !negative};
+        }
+
+        void add_plain(big_integer &r) const {
+            if (negative) {
+                r -= value;
+            } else {
+                r += value;
+            }
+        }
+
+        void add_products(big_integer &) const {}
+
+        bool refers_to(big_integer const &) const {
+            return false;
+        }
+    };
+
+    struct product {
+        big_integer const &a;
+        big_integer const &b;
+        bool negative;
+
+        product operator-() const {
+            return product{a, b, !negative};
+        }
+
+        void add_plain(big_integer &) const {}
+
+        void add_products(big_integer &r) const {
+            if (negative) {
+                submul(r, a, b);
+            } else {
+                addmul(r, a, b);
+            }
+        }
+
+        void add_to(big_integer &r) const {
+            add_products(r);
+        }
+
+        bool refers_to(big_integer const &x) const {
+            return &a == &x || &b == &x;
+        }
+
+        operator big_integer() const {
+            big_integer r;
+            add_to(r);
+            return r;
+        }
+    };
+
+    template <typename L, typename R>
+    struct sum {
+        L left;
+        R right;
+
+        sum operator-() const {
+            return sum{-left, -right};
+        }
+
+        void add_plain(big_integer &r) const {
+            left.add_plain(r);
+            right.add_plain(r);
+        }
+
+        void add_products(big_integer &r) const {
+            left.add_products(r);
+            right.add_products(r);
+        }
+
+        // the plain terms first, the products then accumulate into their sum
+        void add_to(big_integer &r) const {
+            add_plain(r);
+            add_products(r);
+        }
+
+        bool refers_to(big_integer const &x) const {
+            return left.refers_to(x) || right.refers_to(x);
+        }
+
+        operator big_integer() const {
+            big_integer r;
+            add_to(r);
+            return r;
+        }
+    };
+
+    template <typename T>
+    struct is_expression : std::false_type {};
+
+    template <>
+    struct is_expression<product> : std::true_type {};
+
+    template <typename L, typename R>
+    struct is_expression<sum<L, R> > : std::true_type {};
+
+    inline product operator*(operand a, big_integer const &b) {
+        return product{a.value, b, false};
+    }
+
+    inline product operator*(big_integer const &a, operand b) {
+        return product{a, b.value, false};
+    }
+
+    inline product operator*(operand a, operand b) {
+        return product{a.value, b.value, false};
+    }
+
+    template <typename L, typename R>
+    typename std::enable_if<is_expression<L>::value && is_expression<R>::value, sum<L, R> >::type
+    operator+(L const &l, R const &r) {
+        return sum<L, R>{l, r};
+    }
+
+    template <typename L, typename R>
+    typename std::enable_if<is_expression<L>::value && is_expression<R>::value, sum<L, R> >::type
+    operator-(L const &l, R const &r) {
+        return sum<L, R>{l, -r};
+    }
+
+    // the plain operands are taken by value, which keeps integer literals unambiguous
+    template <typename L>
+    typename std::enable_if<is_expression<L>::value, sum<L, term> >::type
+    operator+(L const &l, big_integer r) {
+        return sum<L, term>{l, term{std::move(r), false}};
+    }
+
+    template <typename L>
+    typename std::enable_if<is_expression<L>::value, sum<L, term> >::type
+    operator-(L const &l, big_integer r) {
+        return sum<L, term>{l, term{std::move(r), true}};
+    }
+
+    template <typename R>
+    typename std::enable_if<is_expression<R>::value, sum<term, R> >::type
+    operator+(big_integer l, R const &r) {
+        return sum<term, R>{term{std::move(l), false}, r};
+    }
+
+    template <typename R>
+    typename std::enable_if<is_expression<R>::value, sum<term, R> >::type
+    operator-(big_integer l, R const &r) {
+        return sum<term, R>{term{std::move(l), false}, -r};
+    }
+
+    // a product that reads the destination makes the expression be evaluated on its own first
+    template <typename E>
+    typename std::enable_if<is_expression<E>::value, big_integer &>::type
+    operator+=(big_integer &r, E const &e) {
+        if (e.refers_to(r)) {
+            return r += big_integer(e);
+        }
+        e.add_to(r);
+        return r;
+    }
+
+    template <typename E>
+    typename std::enable_if<is_expression<E>::value, big_integer &>::type
+    operator-=(big_integer &r, E const &e) {
+        if (e.refers_to(r)) {
+            return r -= big_integer(e);
+        }
+        (-e).add_to(r);
+        return r;
+    }
+}
+
+inline bigint_lazy::operand lazy(big_integer const &a) {
+    return bigint_lazy::operand{a};
+}
 
 std::string to_string(big_integer const &a);//
 #endif // BIG_INTEGER_H
@@ -1,11 +1,15 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
 #include <utility>
 #include <gtest/gtest.h>
 
 #include "big_integer.h"
+#include "bigint_kernels.h"
 
 TEST(correctness, two_plus_two)
 {
@@ -735,3 +739,1146 @@ TEST(correctness, div_randomized)
         EXPECT_LT(residue, divisor);
     }
 }
+
+TEST(correctness, mul_negative_limb_boundary)
+{
+    big_integer a("-4294967296");
+    EXPECT_EQ(a * 1, a);
+    EXPECT_EQ(a * a, big_integer("18446744073709551616"));
+
+    big_integer c("-18446744073709551616");
+    EXPECT_EQ(c * 1, c);
+    EXPECT_EQ(c * c, big_integer("340282366920938463463374607431768211456"));
+    EXPECT_EQ(c + 1, big_integer("-18446744073709551615"));
+    EXPECT_EQ(-c - 1, big_integer("18446744073709551615"));
+}
+
+namespace
+{
+    std::vector<limb> rand_limbs(size_t size)
+    {
+        std::vector<limb> result(size);
+        for (size_t i = 0; i != size; ++i)
+            for (unsigned bits = 0; bits < kernels::LIMB_BITS; bits += 16)
+                result[i] = (result[i] << 16) ^ static_cast<limb>(rand());
+        return result;
+    }
+
+    void check_mul_against_basecase(size_t an, size_t bn)
+    {
+        std::vector<limb> a = rand_limbs(an);
+        std::vector<limb> b = rand_limbs(bn);
+        std::vector<limb> expected(an + bn), actual(an + bn);
+        kernels::mul_basecase(expected.data(), a.data(), an, b.data(), bn);
+        kernels::mul(actual.data(), a.data(), an, b.data(), bn);
+        ASSERT_TRUE(expected == actual) << an << " x " << bn;
+    }
+}
+
+TEST(correctness, mul_kernels_randomized)
+{
+    size_t const sizes[] = {1, 31, 32, 33, 64, 100, 159, 160, 161, 479, 480, 1000};
+    for (size_t an : sizes)
+        for (size_t bn : sizes)
+            check_mul_against_basecase(an, bn);
+
+    std::vector<limb> ones(700, std::numeric_limits<limb>::max());
+    std::vector<limb> expected(1400), actual(1400);
+    kernels::mul_basecase(expected.data(), ones.data(), 700, ones.data(), 700);
+    kernels::mul(actual.data(), ones.data(), 700, ones.data(), 700);
+    EXPECT_TRUE(expected == actual);
+}
+
+TEST(correctness, mul_long_randomized)
+{
+    for (unsigned itn = 0; itn != number_of_iterations; ++itn)
+    {
+        big_integer a = rand_big(300);
+        big_integer b = rand_big(500);
+        big_integer c = -rand_big(40);
+
+        EXPECT_EQ(a * (b + c), a * b + a * c);
+        EXPECT_EQ(a * b, b * a);
+        EXPECT_EQ((-a) * b, -(a * b));
+        EXPECT_EQ(a * b / b, a);
+    }
+}
+
+namespace
+{
+    void check_ntt_against_basecase(std::vector<limb> const& a, std::vector<limb> const& b)
+    {
+        std::vector<limb> expected(a.size() + b.size()), actual(a.size() + b.size());
+        kernels::mul_basecase(expected.data(), a.data(), a.size(), b.data(), b.size());
+        kernels::mul_ntt(actual.data(), a.data(), a.size(), b.data(), b.size());
+        ASSERT_TRUE(expected == actual) << a.size() << " x " << b.size();
+    }
+}
+
+TEST(correctness, mul_ntt_randomized)
+{
+    size_t const sizes[] = {1, 2, 7, 64, 1000, 3000};
+    for (size_t an : sizes)
+        for (size_t bn : sizes)
+            check_ntt_against_basecase(rand_limbs(an), rand_limbs(bn));
+
+    std::vector<limb> ones(6000, std::numeric_limits<limb>::max());
+    check_ntt_against_basecase(ones, ones);
+}
+
+TEST(correctness, mul_huge)
+{
+    big_integer a = (big_integer(1) << 400000) - 1;
+    big_integer b = (big_integer(1) << 300000) + 1;
+    big_integer expected = (big_integer(1) << 700000) + (big_integer(1) << 400000) - (big_integer(1) << 300000) - 1;
+    EXPECT_EQ(a * b, expected);
+    EXPECT_EQ(a * a, (big_integer(1) << 800000) - (big_integer(1) << 400001) + 1);
+}
+
+TEST(correctness, string_conv_long)
+{
+    std::string digits;
+    for (size_t i = 0; i != 20000; ++i)
+        digits += static_cast<char>('0' + (i * 7 + i / 13) % 10);
+    digits[0] = '7';
+
+    big_integer expected = 0;
+    for (size_t i = 0; i != digits.size(); ++i)
+        expected = expected * 10 + (digits[i] - '0');
+
+    EXPECT_EQ(big_integer(digits), expected);
+    EXPECT_EQ(big_integer("-" + digits), -expected);
+    EXPECT_EQ(big_integer("000" + digits.substr(0, 1000)), big_integer(digits.substr(0, 1000)));
+    EXPECT_EQ(big_integer("1" + std::string(5000, '0')) - 1, big_integer(std::string(5000, '9')));
+}
+
+TEST(correctness, string_conv_invalid)
+{
+    EXPECT_THROW(big_integer("12a"), std::invalid_argument);
+    EXPECT_THROW(big_integer("--1"), std::invalid_argument);
+}
+
+TEST(correctness, div_large_quotient_digit)
+{
+    big_integer a(std::string(42, '9'));
+    big_integer b("10000000000");
+    EXPECT_EQ(a / b, big_integer(std::string(32, '9')));
+    EXPECT_EQ(a % b, big_integer(std::string(10, '9')));
+}
+
+TEST(correctness, to_string_long)
+{
+    std::string digits;
+    for (size_t i = 0; i != 30000; ++i)
+        digits += static_cast<char>('0' + (i * 7 + i / 13) % 10);
+    digits[0] = '3';
+
+    EXPECT_EQ(to_string(big_integer(digits)), digits);
+    EXPECT_EQ(to_string(big_integer("-" + digits)), "-" + digits);
+
+    std::string sparse = "1" + std::string(4000, '0') + "2" + std::string(4000, '0');
+    EXPECT_EQ(to_string(big_integer(sparse)), sparse);
+
+    big_integer ten = 10;
+    big_integer power = 1;
+    for (size_t i = 0; i != 3000; ++i)
+        power *= ten;
+    EXPECT_EQ(to_string(power), "1" + std::string(3000, '0'));
+    EXPECT_EQ(to_string(power - 1), std::string(3000, '9'));
+}
+
+TEST(correctness, divmod_signs)
+{
+    std::pair<big_integer, big_integer> qr = divmod(big_integer(-7), big_integer(2));
+    EXPECT_EQ(qr.first, -3);
+    EXPECT_EQ(qr.second, -1);
+
+    qr = divmod(big_integer(7), big_integer(-2));
+    EXPECT_EQ(qr.first, -3);
+    EXPECT_EQ(qr.second, 1);
+
+    qr = divmod(big_integer(3), big_integer(-5));
+    EXPECT_EQ(qr.first, 0);
+    EXPECT_EQ(qr.second, 3);
+
+    EXPECT_THROW(divmod(big_integer(3), big_integer(0)), std::runtime_error);
+}
+
+TEST(correctness, div_long_randomized)
+{
+    size_t const sizes[] = {2, 40, 70, 150, 400};
+    for (size_t divisor_size : sizes)
+    {
+        for (unsigned itn = 0; itn != number_of_iterations; ++itn)
+        {
+            big_integer divisor = rand_big(divisor_size);
+            big_integer dividend = rand_big(divisor_size * (itn % 4 + 1) + itn);
+            std::pair<big_integer, big_integer> qr = divmod(dividend, divisor);
+            ASSERT_EQ(qr.first * divisor + qr.second, dividend);
+            EXPECT_GE(qr.second, 0);
+            EXPECT_LT(qr.second, divisor);
+            EXPECT_EQ(dividend / divisor, qr.first);
+            EXPECT_EQ(dividend % divisor, qr.second);
+        }
+    }
+}
+
+TEST(correctness, div_long_extreme_digits)
+{
+    for (int bits = 2000; bits <= 26000; bits += 6000)
+    {
+        big_integer ones = (big_integer(1) << bits) - 1;
+        big_integer divisor = (big_integer(1) << (bits / 2)) - 1;
+        std::pair<big_integer, big_integer> qr = divmod(ones * ones - 1, divisor);
+        EXPECT_EQ(qr.first * divisor + qr.second, ones * ones - 1);
+        EXPECT_LT(qr.second, divisor);
+
+        qr = divmod(ones * divisor, divisor);
+        EXPECT_EQ(qr.first, ones);
+        EXPECT_EQ(qr.second, 0);
+
+        big_integer top = big_integer(1) << (bits - 1);
+        qr = divmod(top * top - 1, top);
+        EXPECT_EQ(qr.first, top - 1);
+        EXPECT_EQ(qr.second, top - 1);
+    }
+}
+
+TEST(correctness, reciprocal_matches_divmod)
+{
+    size_t const sizes[] = {1, 50, 1600};
+    for (size_t divisor_size : sizes)
+    {
+        big_integer divisor = rand_big(divisor_size);
+        reciprocal inverse(divisor);
+        reciprocal negative_inverse(-divisor);
+        for (unsigned itn = 0; itn != 3; ++itn)
+        {
+            big_integer dividend = rand_big(divisor_size * (itn + 1) + 5);
+            std::pair<big_integer, big_integer> expected = divmod(dividend, divisor);
+            std::pair<big_integer, big_integer> actual = inverse.divmod(dividend);
+            ASSERT_EQ(actual.first, expected.first);
+            ASSERT_EQ(actual.second, expected.second);
+            EXPECT_EQ(inverse.quotient(-dividend), -expected.first);
+            EXPECT_EQ(negative_inverse.remainder(-dividend), -expected.second);
+        }
+        EXPECT_EQ(inverse.quotient(divisor - 1), 0);
+        EXPECT_EQ(inverse.remainder(divisor * divisor), 0);
+    }
+}
+
+TEST(correctness, div_newton)
+{
+    // sized in limbs to pass NEWTON_THRESHOLD (4000) and NEWTON_DIVIDEND_RATIO (8) at either limb width
+    int const bits = kernels::LIMB_BITS;
+    big_integer divisor = (big_integer(1) << 4100 * bits) - 12345;
+    big_integer quotient = (big_integer(1) << 35000 * bits) + 987654321;
+    big_integer dividend = divisor * quotient + 42;
+    std::pair<big_integer, big_integer> qr = divmod(dividend, divisor);
+    EXPECT_EQ(qr.first, quotient);
+    EXPECT_EQ(qr.second, 42);
+    EXPECT_EQ(-dividend / divisor, -qr.first);
+    EXPECT_EQ(dividend % -divisor, 42);
+}
+
+TEST(correctness, shr_to_single_limb)
+{
+    big_integer a = (big_integer(7) << 64) + 3;
+    EXPECT_EQ(a >> 64, 7);
+    EXPECT_EQ(a >> 66, 1);
+    EXPECT_EQ(big_integer(5) >> 100, 0);
+    EXPECT_EQ(big_integer(-5) >> 100, -1);
+    EXPECT_EQ((big_integer(1) << 64) >> 96, 0);
+}
+
+TEST(correctness, increment_carry)
+{
+    big_integer a("18446744073709551615");
+    EXPECT_EQ(++a, big_integer("18446744073709551616"));
+    EXPECT_EQ(a--, big_integer("18446744073709551616"));
+    EXPECT_EQ(a, big_integer("18446744073709551615"));
+
+    big_integer b = -1;
+    EXPECT_EQ(b++, -1);
+    EXPECT_EQ(b, 0);
+    EXPECT_EQ(--b, -1);
+    EXPECT_EQ(--b, -2);
+
+    big_integer c("-18446744073709551616");
+    EXPECT_EQ(--c, big_integer("-18446744073709551617"));
+    EXPECT_EQ(++c, big_integer("-18446744073709551616"));
+    EXPECT_EQ(++c, big_integer("-18446744073709551615"));
+}
+
+TEST(correctness, compound_aliasing)
+{
+    big_integer a("-123456789012345678901234567890");
+    big_integer b = a;
+    a += a;
+    EXPECT_EQ(a, b * 2);
+    a -= a;
+    EXPECT_EQ(a, 0);
+
+    a = b;
+    a *= a;
+    EXPECT_EQ(a, b * b);
+    a = b;
+    a &= a;
+    EXPECT_EQ(a, b);
+    a ^= a;
+    EXPECT_EQ(a, 0);
+    EXPECT_EQ(b, big_integer("-123456789012345678901234567890"));
+}
+
+TEST(correctness, compound_randomized)
+{
+    for (unsigned itn = 0; itn != number_of_iterations * 10; ++itn)
+    {
+        big_integer a = rand_big(rand() % 20);
+        big_integer b = rand_big(rand() % 20);
+        if (rand() % 2) a = -a;
+        if (rand() % 2) b = -b;
+        int m = myrand();
+        int s = rand() % 200;
+
+        big_integer c = a;
+        c += b;
+        EXPECT_EQ(c, b + a);
+        c -= b;
+        EXPECT_EQ(c, a);
+        c -= b;
+        EXPECT_EQ(c + b + b, a + b);
+
+        c = a;
+        c *= m;
+        EXPECT_EQ(c, a * big_integer(m));
+        EXPECT_EQ(c / m, a);
+
+        c = a;
+        c <<= s;
+        EXPECT_EQ(c, a * (big_integer(1) << s));
+        c >>= s;
+        EXPECT_EQ(c, a);
+
+        c = a;
+        c |= b;
+        c &= a;
+        EXPECT_EQ(c, a);
+        c ^= b;
+        c ^= b;
+        EXPECT_EQ(c, a);
+    }
+}
+
+TEST(correctness, inline_storage_boundary)
+{
+    for (int k = 1; k < 300; k += 7)
+    {
+        big_integer a = (big_integer(1) << k) - 1;
+        big_integer b = a;
+        b += 2;
+        EXPECT_EQ(b - a, 2);
+        EXPECT_EQ(a * b, (big_integer(1) << (2 * k)) - 1);
+        b -= 2;
+        EXPECT_EQ(a, b);
+        b = -b;
+        b >>= k;
+        EXPECT_EQ(b, -1);
+        EXPECT_EQ(a + 1, big_integer(1) << k);
+    }
+}
+
+TEST(correctness, move_leaves_zero)
+{
+    big_integer a = (big_integer(1) << 500) - 3;
+    big_integer expected = a;
+    big_integer b = std::move(a);
+    EXPECT_EQ(b, expected);
+    EXPECT_EQ(a, 0);
+    a += 5;
+    EXPECT_EQ(a, 5);
+
+    a = std::move(b);
+    EXPECT_EQ(a, expected);
+    EXPECT_EQ(b, 0);
+    a = std::move(a);
+    EXPECT_EQ(a, expected);
+}
+
+TEST(correctness, rvalue_operators)
+{
+    for (unsigned itn = 0; itn != number_of_iterations * 10; ++itn)
+    {
+        big_integer a = rand_big(rand() % 20);
+        big_integer b = rand_big(rand() % 20);
+        big_integer c = rand_big(rand() % 20);
+        if (rand() % 2) a = -a;
+        if (rand() % 2) b = -b;
+
+        big_integer ab = a * b, bc = b * c;
+        EXPECT_EQ(a * b + b * c - a, ab + bc - a);
+        EXPECT_EQ(a - b * c, a - bc);
+        EXPECT_EQ(a - (b - c), a - b + c);
+        EXPECT_EQ((a - b) * (b - c), a * b - a * c - b * b + bc);
+        EXPECT_EQ((a & b) | (b ^ c), big_integer(a & b) | big_integer(b ^ c));
+        EXPECT_EQ(c ^ (a + b), c ^ big_integer(a + b));
+        EXPECT_EQ(b - big_integer(b), 0);
+        EXPECT_EQ((a + b) * 31u, (a + b) * big_integer(31));
+        EXPECT_EQ((a - b) | 1u, (a - b) | big_integer(1));
+    }
+}
+
+TEST(correctness, negative_zero)
+{
+    big_integer a("-0");
+    EXPECT_EQ(a, 0);
+    EXPECT_EQ(to_string(-a), "0");
+    big_integer b = big_integer(5) - 5;
+    EXPECT_EQ(-b, 0);
+    EXPECT_EQ(to_string(big_integer(-7) * 0), "0");
+    EXPECT_EQ(to_string(big_integer(-7) / 8), "0");
+    EXPECT_EQ(to_string(big_integer(-16) % 8), "0");
+    EXPECT_FALSE(big_integer(-1) + 1 < 0);
+}
+
+TEST(correctness, bitwise_shift_randomized)
+{
+    for (unsigned itn = 0; itn != number_of_iterations * 10; ++itn)
+    {
+        big_integer a = rand_big(rand() % 10);
+        big_integer b = rand_big(rand() % 10);
+        if (rand() % 2) a = -a;
+        if (rand() % 2) b = -b;
+        int k = rand() % 300;
+
+        EXPECT_EQ((a & b) + (a | b), a + b);
+        EXPECT_EQ(a ^ b, (a | b) - (a & b));
+        EXPECT_EQ(~a, -a - 1);
+        EXPECT_EQ(~(a & b), ~a | ~b);
+
+        big_integer power = big_integer(1) << k;
+        std::pair<big_integer, big_integer> qr = divmod(a, power);
+        if (qr.second < 0) qr.first -= 1;
+        EXPECT_EQ(a >> k, qr.first);
+        EXPECT_EQ((a << k) >> k, a);
+    }
+}
+
+TEST(correctness, add_sub_kernels_all_lengths)
+{
+    for (size_t n = 1; n != 40; ++n)
+        for (int pattern = 0; pattern != 3; ++pattern)
+        {
+            // all ones against one carries through every limb
+            std::vector<limb> a = rand_limbs(n), b = rand_limbs(n);
+            if (pattern == 1)
+            {
+                std::fill(a.begin(), a.end(), std::numeric_limits<limb>::max());
+                std::fill(b.begin(), b.end(), 0);
+                b[0] = 1;
+            }
+            if (pattern == 2)
+                std::fill(b.begin(), b.end(), std::numeric_limits<limb>::max());
+
+            std::vector<limb> sum(n), difference(n);
+            limb carry = kernels::add_n(sum.data(), a.data(), b.data(), n);
+            limb borrow = kernels::sub_n(difference.data(), a.data(), b.data(), n);
+            limb expected_carry = 0, expected_borrow = 0;
+            for (size_t i = 0; i != n; ++i)
+            {
+                limb s = a[i] + b[i];
+                limb c = s < a[i];
+                s += expected_carry;
+                expected_carry = c | (s < expected_carry);
+                ASSERT_EQ(sum[i], s) << n << " " << i;
+
+                limb d = a[i] - b[i] - expected_borrow;
+                expected_borrow = a[i] < b[i] || (a[i] == b[i] && expected_borrow);
+                ASSERT_EQ(difference[i], d) << n << " " << i;
+            }
+            EXPECT_EQ(carry, expected_carry);
+            EXPECT_EQ(borrow, expected_borrow);
+
+            // in place on either operand
+            std::vector<limb> x = a, y = b;
+            EXPECT_EQ(kernels::add_n(x.data(), x.data(), b.data(), n), carry);
+            EXPECT_TRUE(x == sum);
+            EXPECT_EQ(kernels::sub_n(y.data(), a.data(), y.data(), n), borrow);
+            EXPECT_TRUE(y == difference);
+        }
+}
+
+TEST(correctness, bitwise_kernels_all_lengths)
+{
+    limb const masks[] = {0, ~limb(0)};
+    for (size_t n = 1; n != 70; ++n)
+    {
+        std::vector<limb> a = rand_limbs(n + 1), b = rand_limbs(n);
+        for (limb ma : masks)
+            for (limb mb : masks)
+                for (limb mr : masks)
+                {
+                    std::vector<limb> r_and(n), r_ior(n), r_xor(n);
+                    kernels::and_n(r_and.data(), a.data(), b.data(), n, ma, mb, mr);
+                    kernels::ior_n(r_ior.data(), a.data(), b.data(), n, ma, mb, mr);
+                    kernels::xor_n(r_xor.data(), a.data(), b.data(), n, ma, mb, mr);
+                    for (size_t i = 0; i != n; ++i)
+                    {
+                        ASSERT_EQ(r_and[i], ((a[i] ^ ma) & (b[i] ^ mb)) ^ mr);
+                        ASSERT_EQ(r_ior[i], ((a[i] ^ ma) | (b[i] ^ mb)) ^ mr);
+                        ASSERT_EQ(r_xor[i], a[i] ^ b[i] ^ ma ^ mb ^ mr);
+                    }
+                }
+
+        std::vector<limb> c = a;
+        kernels::com_n(c.data(), c.data(), n);
+        for (size_t i = 0; i != n; ++i)
+            ASSERT_EQ(c[i], ~a[i]);
+
+        // in place, and with the result a limb above or below the operand
+        for (unsigned cnt : {1u, 7u, kernels::LIMB_BITS - 1})
+        {
+            std::vector<limb> l = a, r = a;
+            EXPECT_EQ(kernels::lshift(l.data() + 1, l.data(), n, cnt), a[n - 1] >> (kernels::LIMB_BITS - cnt));
+            EXPECT_EQ(kernels::rshift(r.data(), r.data() + 1, n, cnt), a[1] << (kernels::LIMB_BITS - cnt));
+            for (size_t i = 0; i != n; ++i)
+            {
+                limb below = i ? a[i - 1] >> (kernels::LIMB_BITS - cnt) : 0;
+                limb above = i + 2 <= n ? a[i + 2] << (kernels::LIMB_BITS - cnt) : 0;
+                ASSERT_EQ(l[i + 1], (a[i] << cnt) | below);
+                ASSERT_EQ(r[i], (a[i + 1] >> cnt) | above);
+            }
+            std::vector<limb> x = a, y = a;
+            kernels::lshift(x.data(), x.data(), n, cnt);
+            kernels::rshift(y.data() + 1, y.data() + 1, n, cnt);
+            EXPECT_TRUE(std::equal(x.begin(), x.begin() + n, l.begin() + 1));
+            EXPECT_TRUE(std::equal(y.begin() + 1, y.end(), r.begin()));
+        }
+    }
+}
+
+TEST(correctness, bitwise_long_randomized)
+{
+    for (unsigned itn = 0; itn != number_of_iterations * 10; ++itn)
+    {
+        // low zero limbs make the conversion of negative operands carry far
+        big_integer a = rand_big(rand() % 300 + 1) << (rand() % 1000);
+        big_integer b = rand_big(rand() % 300 + 1) << (rand() % 1000);
+        if (rand() % 2) a = -a;
+        if (rand() % 2) b = -b;
+
+        EXPECT_EQ((a & b) + (a | b), a + b);
+        EXPECT_EQ(a ^ b, (a | b) - (a & b));
+        EXPECT_EQ(a & ~b, a - (a & b));
+        EXPECT_EQ(a ^ -1, ~a);
+
+        int k = rand() % 5000;
+        big_integer power = big_integer(1) << k;
+        EXPECT_EQ(a << k, a * power);
+        std::pair<big_integer, big_integer> qr = divmod(a, power);
+        if (qr.second < 0) qr.first -= 1;
+        EXPECT_EQ(a >> k, qr.first);
+    }
+}
+
+TEST(correctness, pool_size_classes)
+{
+    for (size_t request = 1; request < (size_t(1) << 26); request += request / 7 + 1)
+    {
+        size_t size = request;
+        void* block = bigint_pool::allocate(size);
+        EXPECT_GE(size, request);
+        EXPECT_LE(size, std::max<size_t>(64, request + request / 4));
+        bigint_pool::release(block, size);
+    }
+}
+
+TEST(correctness, scratch_scope_results_outlive_it)
+{
+    big_integer a = rand_big(200), b = rand_big(150);
+    big_integer product, quotient;
+    {
+        bigint_scratch_scope outer;
+        for (int i = 0; i != 10; ++i)
+        {
+            bigint_scratch_scope inner;
+            product = a * b + i;
+            quotient = product / b;
+        }
+    }
+    EXPECT_EQ(quotient, a);
+    EXPECT_EQ(product - 9, a * b);
+
+    std::vector<limb, bigint_allocator<limb>> limbs(1000, 7);
+    limbs.resize(100000, 7);
+    EXPECT_EQ(limbs[99999], 7u);
+}
+
+TEST(correctness, pool_across_threads)
+{
+    // the limbs of every value are released by another thread than the one that made them
+    big_integer const a = rand_big(100), b = rand_big(60);
+    std::vector<big_integer> made(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t != made.size(); ++t)
+        threads.emplace_back([&made, &a, &b, t] {
+            for (int i = 0; i != 200; ++i)
+                made[t] = a * b + big_integer(i) * a;
+        });
+    for (std::thread& t : threads)
+        t.join();
+    threads.clear();
+
+    std::vector<int> checked(made.size());
+    for (size_t t = 0; t != made.size(); ++t)
+        threads.emplace_back([&made, &checked, &a, &b, t] {
+            bigint_scratch_scope scope;
+            checked[t] = (made[t] - b * a) / a == 199;
+            made[t] = 0;
+        });
+    for (std::thread& t : threads)
+        t.join();
+    for (int ok : checked)
+        EXPECT_TRUE(ok);
+}
+
+TEST(correctness, addmul_randomized)
+{
+    size_t const sizes[] = {1, 2, 5, 31, 32, 40, 100};
+    for (size_t an : sizes)
+        for (size_t bn : sizes)
+            for (int signs = 0; signs != 8; ++signs)
+            {
+                big_integer a = rand_big(an), b = rand_big(bn), r = rand_big(rand() % (an + bn + 2));
+                if (signs & 1) a = -a;
+                if (signs & 2) b = -b;
+                if (signs & 4) r = -r;
+
+                big_integer x = r;
+                addmul(x, a, b);
+                EXPECT_EQ(x, r + a * b);
+                x = r;
+                submul(x, a, b);
+                EXPECT_EQ(x, r - a * b);
+
+                // magnitudes close to the product cancel most limbs
+                big_integer close = a * b + (signs & 4 ? 1 : -1);
+                x = close;
+                submul(x, a, b);
+                EXPECT_EQ(x, close - a * b);
+                x = -close;
+                addmul(x, a, b);
+                EXPECT_EQ(x, a * b - close);
+            }
+
+    big_integer a = rand_big(10), x = a;
+    addmul(x, x, x);
+    EXPECT_EQ(x, a + a * a);
+    submul(x, a, 0);
+    EXPECT_EQ(x, a + a * a);
+}
+
+TEST(correctness, lazy_expressions)
+{
+    big_integer a = rand_big(20), b = -rand_big(35), c = rand_big(60), d = rand_big(3), e = -rand_big(40);
+
+    big_integer x = lazy(a) * b + c;
+    EXPECT_EQ(x, a * b + c);
+    x = c - lazy(a) * b;
+    EXPECT_EQ(x, c - a * b);
+    x = lazy(a) * b - lazy(d) * e + c;
+    EXPECT_EQ(x, a * b - d * e + c);
+    x = -(lazy(a) * lazy(b) - c);
+    EXPECT_EQ(x, c - a * b);
+    x = lazy(a) * 3 - 7;
+    EXPECT_EQ(x, a * 3 - 7);
+
+    x = c;
+    x += lazy(a) * b - lazy(d) * e;
+    EXPECT_EQ(x, c + a * b - d * e);
+    x -= lazy(a) * b;
+    EXPECT_EQ(x, c - d * e);
+
+    // the destination inside the expression
+    x = c;
+    x -= lazy(x) * a + x;
+    EXPECT_EQ(x, -c * a);
+
+    std::vector<big_integer> u, v;
+    big_integer dot, expected;
+    for (int i = 0; i != 50; ++i)
+    {
+        u.push_back(rand() % 2 ? rand_big(rand() % 40 + 1) : -rand_big(rand() % 40 + 1));
+        v.push_back(rand() % 2 ? rand_big(rand() % 40 + 1) : -rand_big(rand() % 40 + 1));
+        dot += lazy(u[i]) * v[i];
+        expected += u[i] * v[i];
+    }
+    EXPECT_EQ(dot, expected);
+}
+
+TEST(correctness, accumulator_randomized)
+{
+    std::vector<big_integer> values;
+    big_integer expected;
+    big_integer_accumulator acc;
+    for (int i = 0; i != 2000; ++i)
+    {
+        big_integer x = rand_big(rand() % 30 + 1);
+        if (rand() % 3 == 0)
+            x = -x;
+        values.push_back(x);
+        if (i % 5 == 0)
+        {
+            acc -= x;
+            expected -= x;
+        }
+        else
+        {
+            acc += x;
+            expected += x;
+        }
+    }
+    EXPECT_EQ(acc.value(), expected);
+    acc += 0;
+    acc -= expected;
+    EXPECT_EQ(acc.value(), 0);
+
+    expected = 0;
+    for (size_t i = 0; i != values.size(); ++i)
+        expected += values[i];
+    EXPECT_EQ(sum(values.begin(), values.end()), expected);
+    EXPECT_EQ(sum(values.data(), values.data()), 0);
+
+    // every addition carries out of its top limb
+    big_integer ones = (big_integer(1) << 1000) - 1;
+    acc.clear();
+    for (int i = 0; i != 1000; ++i)
+    {
+        acc += ones;
+        acc -= ones >> (i % 200);
+    }
+    expected = 0;
+    for (int i = 0; i != 1000; ++i)
+        expected += ones - (ones >> (i % 200));
+    EXPECT_EQ(acc.value(), expected);
+}
+
+TEST(correctness, factorial_binomial)
+{
+    big_integer f = 1;
+    for (unsigned n = 0; n != 300; ++n)
+    {
+        if (n > 0)
+            f *= n;
+        EXPECT_EQ(factorial(n), f);
+    }
+    EXPECT_EQ(factorial(3000), factorial(2999) * 3000);
+
+    std::vector<big_integer> row(1, 1);
+    for (unsigned n = 0; n != 100; ++n)
+    {
+        for (unsigned k = 0; k <= n; ++k)
+            EXPECT_EQ(binomial(n, k), row[k]);
+        EXPECT_EQ(binomial(n, n + 1), 0);
+        std::vector<big_integer> next(n + 2, 1);
+        for (unsigned k = 1; k <= n; ++k)
+            next[k] = row[k - 1] + row[k];
+        row = next;
+    }
+
+    // both sides of the sieve threshold
+    for (unsigned k : {5u, 40u, 1000u, 1500u})
+        EXPECT_EQ(binomial(3000, k), factorial(3000) / (factorial(k) * factorial(3000 - k)));
+}
+
+TEST(correctness, product_tree)
+{
+    std::vector<big_integer> values;
+    big_integer expected = 1;
+    for (int i = 0; i != 300; ++i)
+    {
+        big_integer x = rand_big(rand() % 20 + 1);
+        if (rand() % 2)
+            x = -x;
+        values.push_back(x);
+        expected *= x;
+    }
+    EXPECT_EQ(product(values), expected);
+    EXPECT_EQ(product(values.begin(), values.begin() + 1), values[0]);
+    EXPECT_EQ(product(values.begin(), values.begin()), 1);
+
+    int small[] = {3, -4, 5};
+    EXPECT_EQ(product(small, small + 3), -60);
+}
+
+TEST(correctness, thread_budget)
+{
+    unsigned global = bigint_threads();
+    {
+        bigint_thread_scope scope(3);
+        EXPECT_EQ(bigint_threads(), 3u);
+        {
+            bigint_thread_scope inner(5);
+            EXPECT_EQ(bigint_threads(), 5u);
+        }
+        EXPECT_EQ(bigint_threads(), 3u);
+
+        std::vector<int> seen(100);
+        bigint_parallel::for_ranges(seen.size(), [&seen](size_t begin, size_t end) {
+            EXPECT_LE(bigint_threads(), 1u);
+            for (size_t i = begin; i != end; ++i)
+                seen[i]++;
+        });
+        EXPECT_EQ(std::count(seen.begin(), seen.end(), 1), 100);
+
+        EXPECT_THROW(bigint_parallel::invoke([] {}, [] { throw std::runtime_error("worker"); }), std::runtime_error);
+    }
+    EXPECT_EQ(bigint_threads(), global);
+}
+
+TEST(correctness, parallel_matches_serial)
+{
+    auto rand_digits = [](size_t n) {
+        std::string s(n, '0');
+        for (char& c : s)
+            c = static_cast<char>('0' + rand() % 10);
+        s[0] = '7';
+        return s;
+    };
+    // above kernels::PARALLEL_THRESHOLD limbs at either limb width
+    std::string const da = rand_digits(400000), db = rand_digits(390000);
+    big_integer a(da), b(db), small = rand_big(10), medium = rand_big(300);
+
+    big_integer ab = a * b, aa = sqr(a), as = a * small, am = a * medium;
+    EXPECT_EQ(to_string(a), da);
+
+    bigint_thread_scope scope(4);
+    EXPECT_EQ(a * b, ab);
+    EXPECT_EQ(sqr(a), aa);
+    EXPECT_EQ(a * small, as);
+    EXPECT_EQ(a * -medium, -am);
+    EXPECT_EQ(big_integer(db), b);
+    EXPECT_EQ(to_string(a), da);
+    EXPECT_EQ(to_string(-b), "-" + db);
+}
+
+TEST(correctness, pow_mod_small)
+{
+    EXPECT_EQ(pow_mod(4, 13, 497), 445);
+    EXPECT_EQ(pow_mod(4, 13, -497), 445);
+    EXPECT_EQ(pow_mod(-2, 3, 5), 2);
+    EXPECT_EQ(pow_mod(-7, 5, 12), 5);
+    EXPECT_EQ(pow_mod(3, 200, 1000), 1);
+    EXPECT_EQ(pow_mod(3, 0, 7), 1);
+    EXPECT_EQ(pow_mod(3, 0, 1), 0);
+    EXPECT_EQ(pow_mod(0, 5, 7), 0);
+    EXPECT_EQ(pow_mod(123456789, 987654321, big_integer(1) << 64), big_integer("2707128288486860373"));
+    EXPECT_THROW(pow_mod(3, 5, 0), std::runtime_error);
+    EXPECT_THROW(pow_mod(3, -5, 7), std::invalid_argument);
+}
+
+TEST(correctness, pow_mod_randomized)
+{
+    for (unsigned itn = 0; itn != number_of_iterations * 5; ++itn)
+    {
+        big_integer base = rand_big(rand() % 40);
+        big_integer mod = rand_big(rand() % 40) + 1;
+        if (rand() % 2) base = -base;
+        int exp = rand() % 100;
+
+        big_integer expected = 1 % mod;
+        for (int i = 0; i != exp; ++i)
+            expected = expected * base % mod;
+        if (expected < 0)
+            expected += mod;
+        EXPECT_EQ(pow_mod(base, exp, mod), expected);
+    }
+}
+
+TEST(correctness, pow_mod_fermat)
+{
+    // 2^521 - 1 and 2^2203 - 1 are prime, the latter is past the karatsuba threshold
+    for (int bits : {521, 2203})
+    {
+        big_integer p = (big_integer(1) << bits) - 1;
+        for (unsigned itn = 0; itn != number_of_iterations / 2; ++itn)
+        {
+            big_integer a = rand_big(rand() % 300) + 2;
+            if (a % p == 0)
+                continue;
+            EXPECT_EQ(pow_mod(a, p - 1, p), 1);
+            EXPECT_EQ(pow_mod(a, p, p), a % p);
+            EXPECT_EQ(pow_mod(a, p - 2, p) * a % p, 1);
+        }
+    }
+}
+
+TEST(correctness, barrett_reducer_randomized)
+{
+    for (unsigned itn = 0; itn != number_of_iterations * 5; ++itn)
+    {
+        big_integer mod = rand_big(rand() % 60) + 1;
+        if (itn % 5 == 0)
+            mod = big_integer(1) << (rand() % 20 * 32);
+        if (itn % 5 == 1)
+            mod = rand_big(200 + rand() % 100);
+        if (rand() % 2)
+            mod = -mod;
+        barrett_reducer reducer(mod);
+        big_integer m = mod < 0 ? -mod : mod;
+        EXPECT_EQ(reducer.modulus(), m);
+
+        for (int i = 0; i != 10; ++i)
+        {
+            big_integer a = rand_big(rand() % 500);
+            big_integer b = rand_big(rand() % 300);
+            if (rand() % 3 == 0) a = -a;
+            if (rand() % 3 == 0) b = -b;
+
+            big_integer expected = a % m;
+            if (expected < 0) expected += m;
+            EXPECT_EQ(reducer.reduce(a), expected);
+
+            expected = a * b % m;
+            if (expected < 0) expected += m;
+            EXPECT_EQ(reducer.mul_mod(a, b), expected);
+
+            expected = (a + b) % m;
+            if (expected < 0) expected += m;
+            EXPECT_EQ(reducer.add_mod(a, b), expected);
+
+            big_integer ra = reducer.reduce(a), rb = reducer.reduce(b);
+            big_integer out = ra;
+            reducer.mul_mod(out, out, rb);
+            EXPECT_EQ(out, ra * rb % m);
+            reducer.add_mod(out, ra, rb);
+            EXPECT_EQ(out, (ra + rb) % m);
+            reducer.reduce(out, a * a);
+            EXPECT_EQ(out, a * a % m);
+        }
+    }
+}
+
+TEST(correctness, barrett_reducer_small)
+{
+    barrett_reducer one(1);
+    EXPECT_EQ(one.reduce(12345), 0);
+    EXPECT_EQ(one.mul_mod(-3, 7), 0);
+
+    barrett_reducer seven(-7);
+    EXPECT_EQ(seven.reduce(-1), 6);
+    EXPECT_EQ(seven.reduce(-14), 0);
+    EXPECT_EQ(seven.mul_mod(-3, 5), 6);
+    EXPECT_EQ(seven.add_mod(3, 4), 0);
+    EXPECT_EQ(seven.add_mod(6, 6), 5);
+    EXPECT_THROW(barrett_reducer(0), std::runtime_error);
+}
+
+TEST(correctness, barrett_output_shrinks_and_grows)
+{
+    // the same output alternates between inline residues and residues of the full length
+    big_integer mod = rand_big(100) + 1, a = rand_big(150), b = rand_big(90);
+    barrett_reducer reducer(mod);
+    big_integer out = rand_big(90);
+    for (int i = 0; i != 4; ++i)
+    {
+        reducer.reduce(out, mod * (a + i) + 3);
+        EXPECT_EQ(out, 3);
+        reducer.mul_mod(out, a, b + i);
+        EXPECT_EQ(out, a * (b + i) % mod);
+        reducer.mul_mod(out, out, 0);
+        EXPECT_EQ(out, 0);
+        reducer.add_mod(out, mod - 1, 2);
+        EXPECT_EQ(out, 1);
+        reducer.reduce(out, a * a + i);
+        EXPECT_EQ(out, (a * a + i) % mod);
+    }
+}
+
+namespace
+{
+    big_integer euclid_gcd(big_integer a, big_integer b)
+    {
+        if (a < 0) a = -a;
+        if (b < 0) b = -b;
+        while (b != 0)
+        {
+            a %= b;
+            std::swap(a, b);
+        }
+        return a;
+    }
+}
+
+TEST(correctness, gcd_small)
+{
+    EXPECT_EQ(gcd(0, 0), 0);
+    EXPECT_EQ(gcd(0, -5), 5);
+    EXPECT_EQ(gcd(12, 18), 6);
+    EXPECT_EQ(gcd(-12, 18), 6);
+    EXPECT_EQ(gcd(17, 5), 1);
+    EXPECT_EQ(lcm(4, 6), 12);
+    EXPECT_EQ(lcm(-4, 6), 12);
+    EXPECT_EQ(lcm(0, 6), 0);
+    EXPECT_EQ(mod_inverse(3, 7), 5);
+    EXPECT_EQ(mod_inverse(-3, 7), 2);
+    EXPECT_EQ(mod_inverse(5, 1), 0);
+    EXPECT_THROW(mod_inverse(4, 6), std::invalid_argument);
+    EXPECT_THROW(mod_inverse(4, 0), std::runtime_error);
+
+    big_integer g, x, y;
+    std::tie(g, x, y) = ext_gcd(240, 46);
+    EXPECT_EQ(g, 2);
+    EXPECT_EQ(240 * x + 46 * y, 2);
+    std::tie(g, x, y) = ext_gcd(0, -7);
+    EXPECT_EQ(g, 7);
+    EXPECT_EQ(-7 * y, 7);
+}
+
+TEST(correctness, gcd_randomized)
+{
+    for (unsigned itn = 0; itn != number_of_iterations * 10; ++itn)
+    {
+        big_integer common = rand_big(rand() % 30) + 1;
+        big_integer a = rand_big(rand() % 80) * common;
+        big_integer b = rand_big(rand() % 80) * common;
+        if (rand() % 2) a = -a;
+        if (rand() % 2) b = -b;
+
+        big_integer expected = euclid_gcd(a, b);
+        EXPECT_EQ(gcd(a, b), expected);
+
+        big_integer g, x, y;
+        std::tie(g, x, y) = ext_gcd(a, b);
+        EXPECT_EQ(g, expected);
+        EXPECT_EQ(a * x + b * y, g);
+        if (a != 0 && b != 0)
+        {
+            EXPECT_TRUE(x * g <= (b < 0 ? -b : b) && -x * g <= (b < 0 ? -b : b));
+            EXPECT_EQ(lcm(a, b) * g, a * b < 0 ? -(a * b) : a * b);
+        }
+
+        big_integer m = b < 0 ? -b : b;
+        if (m > 1 && expected == 1)
+        {
+            big_integer inverse = mod_inverse(a, m);
+            EXPECT_TRUE(inverse >= 0 && inverse < m);
+            big_integer product = a * inverse % m;
+            EXPECT_EQ(product < 0 ? product + m : product, 1);
+        }
+    }
+}
+
+TEST(correctness, gcd_structured)
+{
+    // consecutive Fibonacci numbers take a quotient of one at every step
+    big_integer f0 = 0, f1 = 1;
+    for (int i = 0; i != 3000; ++i)
+    {
+        f0 += f1;
+        std::swap(f0, f1);
+    }
+    EXPECT_EQ(gcd(f1, f0), 1);
+    big_integer g, x, y;
+    std::tie(g, x, y) = ext_gcd(f1, f0);
+    EXPECT_EQ(f1 * x + f0 * y, 1);
+
+    big_integer p = big_integer(1) << 2000, q = big_integer(1) << 1234;
+    EXPECT_EQ(gcd(p, q), q);
+    EXPECT_EQ(gcd(p * 3, q * 10), q * 2);
+    EXPECT_EQ(gcd(p + 1, p - 1), 1);
+    EXPECT_EQ(mod_inverse(p + 1, (big_integer(1) << 2203) - 1) * (p + 1) % ((big_integer(1) << 2203) - 1), 1);
+}
+
+TEST(correctness, iroot_small)
+{
+    EXPECT_EQ(isqrt(0), 0);
+    EXPECT_EQ(isqrt(1), 1);
+    EXPECT_EQ(isqrt(15), 3);
+    EXPECT_EQ(isqrt(16), 4);
+    EXPECT_EQ(iroot(26, 3), 2);
+    EXPECT_EQ(iroot(27, 3), 3);
+    EXPECT_EQ(iroot(-27, 3), -3);
+    EXPECT_EQ(iroot(-26, 3), -2);
+    EXPECT_EQ(iroot(12345, 1), 12345);
+    EXPECT_EQ(iroot(12345, 100), 1);
+    EXPECT_EQ(iroot(big_integer(1) << 1000, 1000), 2);
+    EXPECT_EQ(iroot((big_integer(1) << 1000) - 1, 1000), 1);
+    EXPECT_THROW(isqrt(-4), std::invalid_argument);
+    EXPECT_THROW(iroot(8, 0), std::invalid_argument);
+}
+
+TEST(correctness, iroot_randomized)
+{
+    for (unsigned itn = 0; itn != number_of_iterations * 5; ++itn)
+    {
+        big_integer a = rand_big(rand() % 300);
+        unsigned k = 1 + rand() % 12;
+        if (itn % 3 == 0)
+            k = 2;
+
+        big_integer r = iroot(a, k);
+        big_integer lower = 1, upper = 1;
+        for (unsigned i = 0; i != k; ++i)
+        {
+            lower *= r;
+            upper *= r + 1;
+        }
+        EXPECT_TRUE(lower <= a);
+        EXPECT_TRUE(upper > a);
+
+        // perfect powers and their neighbours
+        big_integer p = lower;
+        EXPECT_EQ(iroot(p, k), r);
+        if (r > 0)
+        {
+            EXPECT_EQ(iroot(p - 1, k), r - 1);
+        }
+    }
+}
+
+TEST(correctness, sqr_all_sizes)
+{
+    for (size_t n : {1, 2, 5, 31, 47, 48, 49, 100, 159, 160, 161, 400, 1000, 2600})
+    {
+        big_integer a = rand_big(n * 32 / 31 + 1);
+        if (rand() % 2) a = -a;
+        big_integer copy = a;
+        big_integer expected = (a + 1) * (a - 1) + 1;
+
+        EXPECT_EQ(sqr(a), expected);
+        EXPECT_EQ(a * a, expected);
+        EXPECT_EQ(a * copy, expected);
+        copy *= copy;
+        EXPECT_EQ(copy, expected);
+    }
+}
+
+TEST(correctness, pow_small)
+{
+    EXPECT_EQ(pow(big_integer(0), 0), 1);
+    EXPECT_EQ(pow(big_integer(0), 7), 0);
+    EXPECT_EQ(pow(big_integer(-1), 1001), -1);
+    EXPECT_EQ(pow(big_integer(-1), 1000), 1);
+    EXPECT_EQ(pow(big_integer(2), 100), big_integer(1) << 100);
+    EXPECT_EQ(pow(big_integer(-2), 3), -8);
+    EXPECT_EQ(pow(big_integer(-12), 3), -1728);
+    EXPECT_EQ(to_string(pow(big_integer(10), 40)), "1" + std::string(40, '0'));
+    EXPECT_EQ(pow(big_integer(7), 1), 7);
+}
+
+TEST(correctness, pow_randomized)
+{
+    for (unsigned itn = 0; itn != number_of_iterations * 5; ++itn)
+    {
+        big_integer base = rand_big(rand() % 10);
+        base <<= rand() % 70;
+        if (rand() % 2) base = -base;
+        unsigned exp = rand() % 80;
+
+        big_integer expected = 1;
+        for (unsigned i = 0; i != exp; ++i)
+            expected *= base;
+        EXPECT_EQ(pow(base, exp), expected);
+    }
+}
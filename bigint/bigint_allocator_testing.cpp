@@ -0,0 +1,70 @@
+#include <cstdlib>
+#include <gtest/gtest.h>
+
+#include "big_integer.h"
+
+// bigint_set_allocator() has to come before the first block, so these tests have a
+// binary and a main of their own.
+
+namespace
+{
+    size_t live_blocks = 0;
+    size_t live_bytes = 0;
+
+    void* counting_allocate(size_t size)
+    {
+        live_blocks++;
+        live_bytes += size;
+        return ::operator new(size);
+    }
+
+    void counting_release(void* block, size_t size)
+    {
+        live_blocks--;
+        live_bytes -= size;
+        ::operator delete(block);
+    }
+
+    big_integer rand_big(size_t size)
+    {
+        big_integer result = rand();
+        for (size_t i = 0; i != size; ++i)
+        {
+            result *= RAND_MAX;
+            result += rand();
+        }
+        return result;
+    }
+}
+
+TEST(allocator, every_block_goes_through_the_hook)
+{
+    {
+        big_integer a = rand_big(50), b = rand_big(3000);
+        EXPECT_GT(live_blocks, 0u);
+        big_integer c = a * b;
+        EXPECT_EQ(c / a, b);
+        EXPECT_EQ(c % b, 0);
+    }
+    // nothing is kept back by a pool, and release sees the sizes allocate did
+    EXPECT_EQ(live_blocks, 0u);
+    EXPECT_EQ(live_bytes, 0u);
+}
+
+TEST(allocator, scratch_scope_keeps_nothing)
+{
+    {
+        bigint_scratch_scope scope;
+        big_integer a = rand_big(200);
+        for (int i = 0; i != 10; ++i)
+            a = a * a % (rand_big(300) + 1);
+    }
+    EXPECT_EQ(live_blocks, 0u);
+}
+
+int main(int argc, char** argv)
+{
+    bigint_set_allocator(counting_allocate, counting_release);
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,294 @@
+#include "bigint_kernels.h"
+
+// AVX2 and AVX-512 versions of the kernels that run at memory speed, chosen at run time
+// on x86-64. Defining BIGINT_NO_SIMD keeps the portable loops only.
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(BIGINT_NO_SIMD)
+#define BIGINT_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace kernels {
+
+namespace {
+
+enum bit_operation { AND, IOR, XOR };
+
+typedef void (*bitwise_fn)(limb *, const limb *, const limb *, size_t, limb, limb, limb);
+typedef void (*com_fn)(limb *, const limb *, size_t);
+typedef limb (*shift_fn)(limb *, const limb *, size_t, unsigned);
+
+template <int Op>
+void bitwise_generic(limb *r, const limb *a, const limb *b, size_t n, limb ma, limb mb, limb mr) {
+    for (size_t i = 0; i < n; i++) {
+        limb x = a[i] ^ ma, y = b[i] ^ mb;
+        r[i] = (Op == AND ? x & y : Op == IOR ? x | y : x ^ y) ^ mr;
+    }
+}
+
+void com_generic(limb *r, const limb *a, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        r[i] = ~a[i];
+    }
+}
+
+limb lshift_generic(limb *r, const limb *a, size_t n, unsigned cnt) {
+    limb out = a[n - 1] >> (LIMB_BITS - cnt);
+    for (size_t i = n - 1; i > 0; i--) {
+        r[i] = (a[i] << cnt) | (a[i - 1] >> (LIMB_BITS - cnt));
+    }
+    r[0] = a[0] << cnt;
+    return out;
+}
+
+limb rshift_generic(limb *r, const limb *a, size_t n, unsigned cnt) {
+    limb out = a[0] << (LIMB_BITS - cnt);
+    for (size_t i = 0; i + 1 < n; i++) {
+        r[i] = (a[i] >> cnt) | (a[i + 1] << (LIMB_BITS - cnt));
+    }
+    r[n - 1] = a[n - 1] >> cnt;
+    return out;
+}
+
+#ifdef BIGINT_X86_SIMD
+
+// The vector versions are compiled for their instruction sets only, the dispatch below
+// picks the widest one the processor supports the first time a kernel is called.
+// Every loop leaves what does not fill a whole vector to the generic code.
+
+const size_t AVX2_LIMBS = 32 / sizeof(limb);
+const size_t AVX512_LIMBS = 64 / sizeof(limb);
+
+__attribute__((target("avx2")))
+inline __m256i load(const limb *p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+
+__attribute__((target("avx2")))
+inline void store(limb *p, __m256i x) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), x);
+}
+
+__attribute__((target("avx2")))
+inline __m256i sll(__m256i x, __m128i cnt) {
+    return LIMB_BITS == 64 ? _mm256_sll_epi64(x, cnt) : _mm256_sll_epi32(x, cnt);
+}
+
+__attribute__((target("avx2")))
+inline __m256i srl(__m256i x, __m128i cnt) {
+    return LIMB_BITS == 64 ? _mm256_srl_epi64(x, cnt) : _mm256_srl_epi32(x, cnt);
+}
+
+template <int Op>
+__attribute__((target("avx2")))
+void bitwise_avx2(limb *r, const limb *a, const limb *b, size_t n, limb ma, limb mb, limb mr) {
+    const __m256i va = _mm256_set1_epi32(ma ? -1 : 0);
+    const __m256i vb = _mm256_set1_epi32(mb ? -1 : 0);
+    const __m256i vr = _mm256_set1_epi32(mr ? -1 : 0);
+    size_t i = 0;
+    for (; i + AVX2_LIMBS <= n; i += AVX2_LIMBS) {
+        __m256i x = _mm256_xor_si256(load(a + i), va), y = _mm256_xor_si256(load(b + i), vb);
+        __m256i z = Op == AND ? _mm256_and_si256(x, y) : Op == IOR ? _mm256_or_si256(x, y) : _mm256_xor_si256(x, y);
+        store(r + i, _mm256_xor_si256(z, vr));
+    }
+    bitwise_generic<Op>(r + i, a + i, b + i, n - i, ma, mb, mr);
+}
+
+__attribute__((target("avx2")))
+void com_avx2(limb *r, const limb *a, size_t n) {
+    const __m256i ones = _mm256_set1_epi32(-1);
+    size_t i = 0;
+    for (; i + AVX2_LIMBS <= n; i += AVX2_LIMBS) {
+        store(r + i, _mm256_xor_si256(load(a + i), ones));
+    }
+    com_generic(r + i, a + i, n - i);
+}
+
+// walks down from the top, so the limbs of a below the current vector are still unchanged
+// when r is a or lies above it
+__attribute__((target("avx2")))
+limb lshift_avx2(limb *r, const limb *a, size_t n, unsigned cnt) {
+    limb out = a[n - 1] >> (LIMB_BITS - cnt);
+    const __m128i left = _mm_cvtsi32_si128(cnt), right = _mm_cvtsi32_si128(LIMB_BITS - cnt);
+    size_t i = n;
+    for (; i > AVX2_LIMBS; i -= AVX2_LIMBS) {
+        __m256i hi = load(a + i - AVX2_LIMBS), lo = load(a + i - AVX2_LIMBS - 1);
+        store(r + i - AVX2_LIMBS, _mm256_or_si256(sll(hi, left), srl(lo, right)));
+    }
+    lshift_generic(r, a, i, cnt);
+    return out;
+}
+
+// the mirror image, walks up for r at or below a
+__attribute__((target("avx2")))
+limb rshift_avx2(limb *r, const limb *a, size_t n, unsigned cnt) {
+    limb out = a[0] << (LIMB_BITS - cnt);
+    const __m128i right = _mm_cvtsi32_si128(cnt), left = _mm_cvtsi32_si128(LIMB_BITS - cnt);
+    size_t i = 0;
+    for (; i + AVX2_LIMBS < n; i += AVX2_LIMBS) {
+        __m256i lo = load(a + i), hi = load(a + i + 1);
+        store(r + i, _mm256_or_si256(srl(lo, right), sll(hi, left)));
+    }
+    rshift_generic(r + i, a + i, n - i, cnt);
+    return out;
+}
+
+__attribute__((target("avx512f")))
+inline __m512i load512(const limb *p) {
+    return _mm512_loadu_si512(p);
+}
+
+__attribute__((target("avx512f")))
+inline void store512(limb *p, __m512i x) {
+    _mm512_storeu_si512(p, x);
+}
+
+// the zero-masking forms with every lane selected, the plain ones start from an
+// undefined vector that gcc warns about
+__attribute__((target("avx512f")))
+inline __m512i sll(__m512i x, __m128i cnt) {
+    return LIMB_BITS == 64 ? _mm512_maskz_sll_epi64(0xff, x, cnt) : _mm512_maskz_sll_epi32(0xffff, x, cnt);
+}
+
+__attribute__((target("avx512f")))
+inline __m512i srl(__m512i x, __m128i cnt) {
+    return LIMB_BITS == 64 ? _mm512_maskz_srl_epi64(0xff, x, cnt) : _mm512_maskz_srl_epi32(0xffff, x, cnt);
+}
+
+template <int Op>
+__attribute__((target("avx512f")))
+void bitwise_avx512(limb *r, const limb *a, const limb *b, size_t n, limb ma, limb mb, limb mr) {
+    const __m512i va = _mm512_set1_epi32(ma ? -1 : 0);
+    const __m512i vb = _mm512_set1_epi32(mb ? -1 : 0);
+    const __m512i vr = _mm512_set1_epi32(mr ? -1 : 0);
+    size_t i = 0;
+    for (; i + AVX512_LIMBS <= n; i += AVX512_LIMBS) {
+        __m512i x = _mm512_xor_si512(load512(a + i), va), y = _mm512_xor_si512(load512(b + i), vb);
+        __m512i z = Op == AND ? _mm512_and_si512(x, y) : Op == IOR ? _mm512_or_si512(x, y) : _mm512_xor_si512(x, y);
+        store512(r + i, _mm512_xor_si512(z, vr));
+    }
+    bitwise_generic<Op>(r + i, a + i, b + i, n - i, ma, mb, mr);
+}
+
+__attribute__((target("avx512f")))
+void com_avx512(limb *r, const limb *a, size_t n) {
+    const __m512i ones = _mm512_set1_epi32(-1);
+    size_t i = 0;
+    for (; i + AVX512_LIMBS <= n; i += AVX512_LIMBS) {
+        store512(r + i, _mm512_xor_si512(load512(a + i), ones));
+    }
+    com_generic(r + i, a + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+limb lshift_avx512(limb *r, const limb *a, size_t n, unsigned cnt) {
+    limb out = a[n - 1] >> (LIMB_BITS - cnt);
+    const __m128i left = _mm_cvtsi32_si128(cnt), right = _mm_cvtsi32_si128(LIMB_BITS - cnt);
+    size_t i = n;
+    for (; i > AVX512_LIMBS; i -= AVX512_LIMBS) {
+        __m512i hi = load512(a + i - AVX512_LIMBS), lo = load512(a + i - AVX512_LIMBS - 1);
+        store512(r + i - AVX512_LIMBS, _mm512_or_si512(sll(hi, left), srl(lo, right)));
+    }
+    lshift_generic(r, a, i, cnt);
+    return out;
+}
+
+__attribute__((target("avx512f")))
+limb rshift_avx512(limb *r, const limb *a, size_t n, unsigned cnt) {
+    limb out = a[0] << (LIMB_BITS - cnt);
+    const __m128i right = _mm_cvtsi32_si128(cnt), left = _mm_cvtsi32_si128(LIMB_BITS - cnt);
+    size_t i = 0;
+    for (; i + AVX512_LIMBS < n; i += AVX512_LIMBS) {
+        __m512i lo = load512(a + i), hi = load512(a + i + 1);
+        store512(r + i, _mm512_or_si512(srl(lo, right), sll(hi, left)));
+    }
+    rshift_generic(r + i, a + i, n - i, cnt);
+    return out;
+}
+
+enum simd_level { GENERIC, AVX2, AVX512 };
+
+simd_level detect_simd() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return AVX512;
+    }
+    return __builtin_cpu_supports("avx2") ? AVX2 : GENERIC;
+}
+
+template <typename F>
+F pick(F avx512, F avx2, F generic) {
+    static const simd_level level = detect_simd();
+    return level == AVX512 ? avx512 : level == AVX2 ? avx2 : generic;
+}
+
+template <int Op>
+bitwise_fn select_bitwise() {
+    return pick<bitwise_fn>(bitwise_avx512<Op>, bitwise_avx2<Op>, bitwise_generic<Op>);
+}
+
+com_fn select_com() {
+    return pick<com_fn>(com_avx512, com_avx2, com_generic);
+}
+
+shift_fn select_lshift() {
+    return pick<shift_fn>(lshift_avx512, lshift_avx2, lshift_generic);
+}
+
+shift_fn select_rshift() {
+    return pick<shift_fn>(rshift_avx512, rshift_avx2, rshift_generic);
+}
+
+#else
+
+template <int Op>
+bitwise_fn select_bitwise() {
+    return bitwise_generic<Op>;
+}
+
+com_fn select_com() {
+    return com_generic;
+}
+
+shift_fn select_lshift() {
+    return lshift_generic;
+}
+
+shift_fn select_rshift() {
+    return rshift_generic;
+}
+
+#endif
+
+}
+
+void and_n(limb *r, const limb *a, const limb *b, size_t n, limb ma, limb mb, limb mr) {
+    static const bitwise_fn kernel = select_bitwise<AND>();
+    kernel(r, a, b, n, ma, mb, mr);
+}
+
+void ior_n(limb *r, const limb *a, const limb *b, size_t n, limb ma, limb mb, limb mr) {
+    static const bitwise_fn kernel = select_bitwise<IOR>();
+    kernel(r, a, b, n, ma, mb, mr);
+}
+
+void xor_n(limb *r, const limb *a, const limb *b, size_t n, limb ma, limb mb, limb mr) {
+    static const bitwise_fn kernel = select_bitwise<XOR>();
+    kernel(r, a, b, n, ma, mb, mr);
+}
+
+void com_n(limb *r, const limb *a, size_t n) {
+    static const com_fn kernel = select_com();
+    kernel(r, a, n);
+}
+
+limb lshift(limb *r, const limb *a, size_t n, unsigned cnt) {
+    static const shift_fn kernel = select_lshift();
+    return kernel(r, a, n, cnt);
+}
+
+limb rshift(limb *r, const limb *a, size_t n, unsigned cnt) {
+    static const shift_fn kernel = select_rshift();
+    return kernel(r, a, n, cnt);
+}
+
+}
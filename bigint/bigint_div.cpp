@@ -0,0 +1,169 @@
+#include "bigint_kernels.h"
+#include <algorithm>
+#include <vector>
+
+namespace kernels {
+
+// Divisor size in limbs from which the recursive division wins over the schoolbook one,
+// and the block size below which its recursion falls back to the schoolbook division.
+const size_t BZ_THRESHOLD = 300;
+const size_t BZ_BASECASE = 60;
+
+// Modulus size in limbs below which Barrett reduction computes only the halves of its
+// two products it needs, in rows of addmul_1, instead of whole products by mul_n.
+const size_t BARRETT_HALF_THRESHOLD = 80;
+
+namespace {
+
+// Knuth's algorithm D. b is normalized, a[an - bn, an) < b.
+// q[0, an - bn) = a / b, the remainder is left in a[0, bn).
+void divrem_basecase(limb *q, limb *a, size_t an, const limb *b, size_t bn) {
+    const limb b1 = b[bn - 1];
+    const limb b2 = bn > 1 ? b[bn - 2] : 0;
+    for (size_t j = an - bn; j-- > 0;) {
+        limb n1 = a[j + bn], n0 = a[j + bn - 1];
+        double_limb qhat = std::numeric_limits<limb>::max();
+        if (n1 < b1) {
+            limb r;
+            qhat = div_2by1(n1, n0, b1, r);
+            double_limb rhat = r;
+            limb n2 = bn > 1 ? a[j + bn - 2] : 0;
+            while (qhat * b2 > ((rhat << LIMB_BITS) | n2)) {
+                qhat--;
+                rhat += b1;
+                if (rhat >> LIMB_BITS) break;
+            }
+        }
+        limb hi = n1 - submul_1(a + j, b, bn, static_cast<limb>(qhat));
+        while (hi != 0) {
+            qhat--;
+            hi += add_n(a + j, a + j, b, bn);
+        }
+        a[j + bn] = 0;
+        q[j] = static_cast<limb>(qhat);
+    }
+}
+
+void div_2n_1n(limb *q, limb *a, const limb *b, size_t n, limb *scratch);
+
+// Burnikel-Ziegler: a[0, 3h) / b[0, 2h) with a[h, 3h) < b.
+// q[0, h) gets the quotient, the remainder is left in a[0, 2h).
+void div_3n_2n(limb *q, limb *a, const limb *b, size_t h, limb *scratch) {
+    const limb *b1 = b + h, *b2 = b;
+    limb top = 0;
+    if (cmp(a + 2 * h, b1, h) < 0) {
+        div_2n_1n(q, a + h, b1, h, scratch);
+    } else {
+        // a1 == b1: q = B^h - 1 and [a1, a2] - q * b1 = a2 + b1
+        std::fill(q, q + h, std::numeric_limits<limb>::max());
+        top = add_n(a + h, a + h, b1, h);
+    }
+
+    limb *d = scratch;
+    mul(d, q, h, b2, h);
+    limb hi = top - sub_n(a, a, d, 2 * h);
+    while (hi != 0) {
+        sub_1(q, q, h, 1);
+        hi += add_n(a, a, b, 2 * h);
+    }
+}
+
+// a[0, 2n) / b[0, n) with a[n, 2n) < b, quotient to q[0, n), remainder to a[0, n)
+void div_2n_1n(limb *q, limb *a, const limb *b, size_t n, limb *scratch) {
+    if (n % 2 != 0 || n < BZ_BASECASE) {
+        divrem_basecase(q, a, 2 * n, b, n);
+        return;
+    }
+    size_t h = n / 2;
+    div_3n_2n(q + h, a + h, b, h, scratch);
+    div_3n_2n(q, a, b, h, scratch);
+}
+
+// Same contract as divrem_basecase, the remainder goes to r[0, bn). The divisor is padded
+// with low zero limbs up to j * 2^k limbs, j < BZ_BASECASE, and the dividend is divided
+// block by block.
+void divrem_bz(limb *q, limb *r, const limb *a, size_t an, const limb *b, size_t bn) {
+    size_t blocks = bn, levels = 0;
+    while (blocks >= BZ_BASECASE) {
+        blocks = (blocks + 1) / 2;
+        levels++;
+    }
+    size_t n = blocks << levels, pad = n - bn;
+    size_t t = (an + pad) / n + 1;
+
+    limb_vector a_pad(t * n, 0), b_pad(n, 0), q_pad((t - 1) * n);
+    std::copy(a, a + an, a_pad.begin() + pad);
+    std::copy(b, b + bn, b_pad.begin() + pad);
+    limb_vector scratch(2 * n);
+
+    for (size_t i = t - 1; i-- > 0;) {
+        div_2n_1n(q_pad.data() + i * n, a_pad.data() + i * n, b_pad.data(), n, scratch.data());
+    }
+    std::copy(q_pad.begin(), q_pad.begin() + (an - bn), q);
+    std::copy(a_pad.begin() + pad, a_pad.begin() + pad + bn, r);
+}
+
+}
+
+void divrem(limb *q, limb *r, const limb *a, size_t an, const limb *b, size_t bn) {
+    if (bn == 1) {
+        r[0] = divrem_1(q, a, an, b[0]);
+        return;
+    }
+
+    // normalize so that the top bit of the divisor is set
+    unsigned shift = clz(b[bn - 1]);
+    limb_vector a_norm(a, a + an), b_norm(b, b + bn);
+    a_norm.push_back(0);
+    if (shift) {
+        lshift(b_norm.data(), b_norm.data(), bn, shift);
+        a_norm[an] = lshift(a_norm.data(), a_norm.data(), an, shift);
+    }
+
+    if (bn < BZ_THRESHOLD) {
+        divrem_basecase(q, a_norm.data(), an + 1, b_norm.data(), bn);
+    } else {
+        divrem_bz(q, a_norm.data(), a_norm.data(), an + 1, b_norm.data(), bn);
+    }
+
+    if (shift) {
+        rshift(r, a_norm.data(), bn, shift);
+    } else {
+        std::copy(a_norm.begin(), a_norm.begin() + bn, r);
+    }
+}
+
+size_t barrett_scratch_size(size_t n) {
+    return 4 * n + 4 + mul_scratch_size(n + 1);
+}
+
+// The quotient estimate from the top n + 1 limbs of w is short by at most 2, and by at most
+// 2 more when inv is capped or its low products are skipped, so the remainder is found
+// modulo B^(n + 1) and finished by subtractions.
+void barrett_reduce(limb *w, const limb *m, const limb *inv, size_t n, limb *scratch) {
+    limb *q = scratch;
+    limb *p = q + 2 * n + 2;
+    const limb *w1 = w + n - 1;
+    const limb *q3 = q + n + 1;
+    if (n + 1 < BARRETT_HALF_THRESHOLD) {
+        // only the columns from n - 1 on of w1 * inv, only the low n + 1 limbs of q3 * m
+        std::fill(q, q + 2 * n + 2, 0);
+        for (size_t i = 0; i <= n; i++) {
+            size_t j = i < n - 1 ? n - 1 - i : 0;
+            q[i + n + 1] = addmul_1(q + i + j, inv + j, n + 1 - j, w1[i]);
+        }
+        std::fill(p, p + n + 1, 0);
+        for (size_t i = 0; i <= n; i++) {
+            addmul_1(p + i, m, n + 1 - i, q3[i]);
+        }
+    } else {
+        mul_n(q, w1, inv, n + 1, p + 2 * n + 2);
+        mul_n(p, q3, m, n + 1, p + 2 * n + 2);
+    }
+    sub_n(w, w, p, n + 1);
+    while (w[n] != 0 || cmp(w, m, n) >= 0) {
+        w[n] -= sub_n(w, w, m, n);
+    }
+}
+
+}
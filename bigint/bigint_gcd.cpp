@@ -0,0 +1,229 @@
+#include "bigint_kernels.h"
+#include <algorithm>
+#include <vector>
+
+namespace kernels {
+
+namespace {
+
+#if BIGINT_LIMB_BITS == 64
+__extension__ typedef __int128 signed_double_limb;
+#else
+typedef int64_t signed_double_limb;
+#endif
+
+size_t trim(const limb *x, size_t n) {
+    while (n > 0 && x[n - 1] == 0) {
+        n--;
+    }
+    return n;
+}
+
+unsigned ctz(double_limb x) {
+    limb lo = static_cast<limb>(x);
+    return lo ? kernels::ctz(lo) : LIMB_BITS + kernels::ctz(static_cast<limb>(x >> LIMB_BITS));
+}
+
+double_limb to_double_limb(const limb *x, size_t n) {
+    double_limb r = n > 1 ? x[1] : 0;
+    return n > 0 ? (r << LIMB_BITS) | x[0] : 0;
+}
+
+// Stein's algorithm, for what is left once the operands fit two limbs
+double_limb binary_gcd(double_limb x, double_limb y) {
+    if (x == 0 || y == 0) {
+        return x | y;
+    }
+    unsigned shift = ctz(x | y);
+    x >>= ctz(x);
+    do {
+        y >>= ctz(y);
+        if (x > y) {
+            std::swap(x, y);
+        }
+        y -= x;
+    } while (y != 0);
+    return x << shift;
+}
+
+// bits [shift, shift + 2 LIMB_BITS) of x
+double_limb bits_at(const limb *x, size_t n, size_t shift) {
+    size_t w = shift / LIMB_BITS;
+    unsigned off = shift % LIMB_BITS;
+    limb x0 = w < n ? x[w] : 0, x1 = w + 1 < n ? x[w + 1] : 0, x2 = w + 2 < n ? x[w + 2] : 0;
+    if (off) {
+        x0 = (x0 >> off) | (x1 << (LIMB_BITS - off));
+        x1 = (x1 >> off) | (x2 << (LIMB_BITS - off));
+    }
+    return (static_cast<double_limb>(x1) << LIMB_BITS) | x0;
+}
+
+// Knuth's algorithm L on the leading 2 LIMB_BITS - 2 bits ah of a and the bits bh of b
+// at the same positions. Euclid runs on them as long as the quotients bounded by
+// (ah + A) / (bh + C) and (ah + B) / (bh + D) agree and the cofactors stay below B / 2.
+// After k steps a_k = A a + B b, a_(k+1) = C a + D b, where A and D have the sign
+// (-1)^k and B and C the opposite one. Returns k, the magnitudes go to m.
+size_t lehmer_matrix(double_limb ah, double_limb bh, limb m[4]) {
+    typedef signed_double_limb sd;
+    const sd limit = sd(1) << (LIMB_BITS - 1);
+    sd x = static_cast<sd>(ah), y = static_cast<sd>(bh);
+    sd A = 1, B = 0, C = 0, D = 1;
+    size_t k = 0;
+    while (y + C > 0 && y + D > 0 && x + A >= 0 && x + B >= 0) {
+        sd q = (x + A) / (y + C);
+        if (q != (x + B) / (y + D) || q > limit) {
+            break;
+        }
+        sd c = A - q * C, d = B - q * D;
+        if (c > limit || c < -limit || d > limit || d < -limit) {
+            break;
+        }
+        A = C;
+        B = D;
+        C = c;
+        D = d;
+        sd t = x - q * y;
+        x = y;
+        y = t;
+        k++;
+    }
+    m[0] = static_cast<limb>(A < 0 ? -A : A);
+    m[1] = static_cast<limb>(B < 0 ? -B : B);
+    m[2] = static_cast<limb>(C < 0 ? -C : C);
+    m[3] = static_cast<limb>(D < 0 ? -D : D);
+    return k;
+}
+
+// r[0, n] = x u - y v, known to be non-negative
+void mul_sub(limb *r, const limb *u, limb x, const limb *v, limb y, size_t n) {
+    r[n] = mul_1(r, u, n, x);
+    r[n] -= submul_1(r, v, n, y);
+}
+
+// r[0, n] = x u + y v
+void mul_add(limb *r, const limb *u, limb x, const limb *v, limb y, size_t n) {
+    r[n] = mul_1(r, u, n, x);
+    r[n] += addmul_1(r, v, n, y);
+}
+
+// The remainder sequence a_0 = a, a_1 = b, a_(i+2) = a_i mod a_(i+1) walked by Lehmer
+// steps of up to a limb of quotients each, with a full division whenever the leading
+// bits cannot decide the next quotient. With cofactors, |u_i| and |u_(i+1)| follow,
+// a_i = u_i a mod b, where u_i has the sign (-1)^i.
+struct euclid {
+    limb_vector a, b, t, q;
+    size_t an, bn;
+    size_t index;
+
+    bool cofactors;
+    limb_vector u0, u1, ut, uq;
+    size_t un;
+
+    euclid(const limb *x, size_t xn, const limb *y, size_t yn, bool cofactors)
+            : a(xn + 1), b(xn + 1), t(xn + 1), q(xn + 1), an(xn), bn(yn), index(0), cofactors(cofactors), un(1) {
+        std::copy(x, x + xn, a.begin());
+        std::copy(y, y + yn, b.begin());
+        if (cofactors) {
+            u0.assign(yn + 2, 0);
+            u1.assign(yn + 2, 0);
+            ut.assign(yn + 2, 0);
+            uq.assign(yn + 2, 0);
+            u0[0] = 1;
+        }
+    }
+
+    bool lehmer_step() {
+        size_t shift = an * LIMB_BITS - clz(a[an - 1]) - (2 * LIMB_BITS - 2);
+        limb m[4];
+        size_t k = lehmer_matrix(bits_at(a.data(), an, shift), bits_at(b.data(), an, shift), m);
+        if (k == 0) {
+            return false;
+        }
+        if (k % 2 == 0) {
+            mul_sub(t.data(), a.data(), m[0], b.data(), m[1], an);
+            mul_sub(q.data(), b.data(), m[3], a.data(), m[2], an);
+        } else {
+            mul_sub(t.data(), b.data(), m[1], a.data(), m[0], an);
+            mul_sub(q.data(), a.data(), m[2], b.data(), m[3], an);
+        }
+        a.swap(t);
+        b.swap(q);
+        bn = trim(b.data(), an);
+        an = trim(a.data(), an);
+        if (cofactors) {
+            std::fill(ut.begin(), ut.end(), 0);
+            std::fill(uq.begin(), uq.end(), 0);
+            mul_add(ut.data(), u0.data(), m[0], u1.data(), m[1], un);
+            mul_add(uq.data(), u0.data(), m[2], u1.data(), m[3], un);
+            u0.swap(ut);
+            u1.swap(uq);
+            un = std::max(trim(u0.data(), un + 1), trim(u1.data(), un + 1));
+        }
+        index += k;
+        return true;
+    }
+
+    void division_step() {
+        divrem(q.data(), t.data(), a.data(), an, b.data(), bn);
+        size_t qn = trim(q.data(), an - bn + 1);
+        a.swap(b);
+        b.swap(t);
+        an = bn;
+        bn = trim(b.data(), an);
+        if (cofactors) {
+            // u_(i+2) = u_i - q u_(i+1), the two terms have the same sign and
+            // |u_(i+1)| >= |u_i| once u_(i+1) != 0
+            size_t u0n = trim(u0.data(), un), u1n = trim(u1.data(), un);
+            std::fill(ut.begin(), ut.end(), 0);
+            if (u1n == 0) {
+                std::copy(u0.begin(), u0.begin() + u0n, ut.begin());
+            } else {
+                mul(ut.data(), u1.data(), u1n, q.data(), qn);
+                add(ut.data(), ut.data(), u1n + qn, u0.data(), u0n);
+            }
+            u0.swap(u1);
+            u1.swap(ut);
+            un = std::max(u1n, trim(u1.data(), u1.size()));
+        }
+        index++;
+    }
+};
+
+}
+
+size_t gcd(limb *g, const limb *a, size_t an, const limb *b, size_t bn) {
+    if (an < bn || (an == bn && cmp(a, b, an) < 0)) {
+        std::swap(a, b);
+        std::swap(an, bn);
+    }
+    euclid e(a, an, b, bn, false);
+    while (e.bn > 0 && e.an > 2) {
+        if (!e.lehmer_step()) {
+            e.division_step();
+        }
+    }
+    if (e.bn == 0) {
+        std::copy(e.a.begin(), e.a.begin() + e.an, g);
+        return e.an;
+    }
+    double_limb r = binary_gcd(to_double_limb(e.a.data(), e.an), to_double_limb(e.b.data(), e.bn));
+    g[0] = static_cast<limb>(r);
+    g[1] = static_cast<limb>(r >> LIMB_BITS);
+    return g[1] ? 2 : 1;
+}
+
+size_t gcdext(limb *g, limb *s, size_t &sn, bool &s_negative, const limb *a, size_t an, const limb *b, size_t bn) {
+    euclid e(a, an, b, bn, true);
+    while (e.bn > 0) {
+        if (e.an <= 2 || !e.lehmer_step()) {
+            e.division_step();
+        }
+    }
+    std::copy(e.a.begin(), e.a.begin() + e.an, g);
+    sn = trim(e.u0.data(), e.un);
+    std::copy(e.u0.begin(), e.u0.begin() + sn, s);
+    s_negative = e.index % 2 == 1;
+    return e.an;
+}
+
+}
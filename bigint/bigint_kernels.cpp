@@ -0,0 +1,465 @@
+#include "bigint_kernels.h"
+#include "bigint_threads.h"
+#include <algorithm>
+#include <vector>
+
+namespace kernels {
+
+// Operand sizes in limbs from which the recursive algorithms win over their predecessors.
+const size_t KARATSUBA_THRESHOLD = 32;
+const size_t TOOM3_THRESHOLD = 160;
+const size_t NTT_THRESHOLD = 2500;
+
+// The same for squares, whose basecase does half the multiplications.
+const size_t SQR_KARATSUBA_THRESHOLD = 48;
+
+//________________________________________________________
+
+int cmp(const limb *a, const limb *b, size_t n) {
+    for (size_t i = n; i > 0; i--) {
+        if (a[i - 1] != b[i - 1]) {
+            return a[i - 1] < b[i - 1] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+limb add_1(limb *r, const limb *a, size_t n, limb b) {
+    size_t i = 0;
+    for (; i < n && b != 0; i++) {
+        limb s = a[i] + b;
+        b = s < b;
+        r[i] = s;
+    }
+    if (r != a) {
+        std::copy(a + i, a + n, r + i);
+    }
+    return b;
+}
+
+limb sub_1(limb *r, const limb *a, size_t n, limb b) {
+    size_t i = 0;
+    for (; i < n && b != 0; i++) {
+        limb s = a[i];
+        r[i] = s - b;
+        b = s < b;
+    }
+    if (r != a) {
+        std::copy(a + i, a + n, r + i);
+    }
+    return b;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BIGINT_X86_CARRY_CHAIN
+
+namespace {
+
+// Four limbs of r = a + b or a - b per iteration of a single adc or sbb chain that runs
+// through the whole loop, since lea and dec leave the carry flag alone. c is the
+// incoming and returns the outgoing carry or borrow.
+#define BIGINT_CARRY_CHAIN(insn)                                                    \
+    limb t0, t1, t2, t3;                                                            \
+    __asm__ __volatile__(                                                           \
+        "add $-1, %[c]\n\t"                                                         \
+        "1:\n\t"                                                                    \
+        "mov (%[a]), %[t0]\n\t"                                                     \
+        "mov %c[s1](%[a]), %[t1]\n\t"                                               \
+        "mov %c[s2](%[a]), %[t2]\n\t"                                               \
+        "mov %c[s3](%[a]), %[t3]\n\t"                                               \
+        insn " (%[b]), %[t0]\n\t"                                                   \
+        insn " %c[s1](%[b]), %[t1]\n\t"                                             \
+        insn " %c[s2](%[b]), %[t2]\n\t"                                             \
+        insn " %c[s3](%[b]), %[t3]\n\t"                                             \
+        "mov %[t0], (%[r])\n\t"                                                     \
+        "mov %[t1], %c[s1](%[r])\n\t"                                               \
+        "mov %[t2], %c[s2](%[r])\n\t"                                               \
+        "mov %[t3], %c[s3](%[r])\n\t"                                               \
+        "lea %c[s4](%[a]), %[a]\n\t"                                                \
+        "lea %c[s4](%[b]), %[b]\n\t"                                                \
+        "lea %c[s4](%[r]), %[r]\n\t"                                                \
+        "dec %[blocks]\n\t"                                                         \
+        "jnz 1b\n\t"                                                                \
+        "sbb %[c], %[c]"                                                            \
+        : [r] "+r"(r), [a] "+r"(a), [b] "+r"(b), [blocks] "+r"(blocks),             \
+          [c] "+r"(c), [t0] "=&r"(t0), [t1] "=&r"(t1), [t2] "=&r"(t2),              \
+          [t3] "=&r"(t3)                                                            \
+        : [s1] "i"(sizeof(limb)), [s2] "i"(2 * sizeof(limb)),                       \
+          [s3] "i"(3 * sizeof(limb)), [s4] "i"(4 * sizeof(limb))                    \
+        : "cc", "memory")
+
+// blocks > 0
+limb add_blocks(limb *r, const limb *a, const limb *b, size_t blocks, limb c) {
+    BIGINT_CARRY_CHAIN("adc");
+    return c & 1;
+}
+
+limb sub_blocks(limb *r, const limb *a, const limb *b, size_t blocks, limb c) {
+    BIGINT_CARRY_CHAIN("sbb");
+    return c & 1;
+}
+
+#undef BIGINT_CARRY_CHAIN
+
+}
+
+#endif
+
+limb add_n(limb *r, const limb *a, const limb *b, size_t n) {
+    double_limb carry = 0;
+    size_t i = 0;
+#ifdef BIGINT_X86_CARRY_CHAIN
+    i = n - n % 4;
+    if (i) {
+        carry = add_blocks(r, a, b, i / 4, 0);
+    }
+#endif
+    for (; i < n; i++) {
+        carry += static_cast<double_limb>(a[i]) + b[i];
+        r[i] = static_cast<limb>(carry);
+        carry >>= LIMB_BITS;
+    }
+    return static_cast<limb>(carry);
+}
+
+limb sub_n(limb *r, const limb *a, const limb *b, size_t n) {
+    limb borrow = 0;
+    size_t i = 0;
+#ifdef BIGINT_X86_CARRY_CHAIN
+    i = n - n % 4;
+    if (i) {
+        borrow = sub_blocks(r, a, b, i / 4, 0);
+    }
+#endif
+    for (; i < n; i++) {
+        limb x = a[i], y = b[i];
+        limb d = x - y - borrow;
+        borrow = (x < y) || (x == y && borrow);
+        r[i] = d;
+    }
+    return borrow;
+}
+
+limb add(limb *r, const limb *a, size_t an, const limb *b, size_t bn) {
+    limb carry = add_n(r, a, b, bn);
+    return add_1(r + bn, a + bn, an - bn, carry);
+}
+
+limb sub(limb *r, const limb *a, size_t an, const limb *b, size_t bn) {
+    limb borrow = sub_n(r, a, b, bn);
+    return sub_1(r + bn, a + bn, an - bn, borrow);
+}
+
+limb mul_1(limb *r, const limb *a, size_t n, limb b) {
+    double_limb carry = 0;
+    for (size_t i = 0; i < n; i++) {
+        carry += static_cast<double_limb>(a[i]) * b;
+        r[i] = static_cast<limb>(carry);
+        carry >>= LIMB_BITS;
+    }
+    return static_cast<limb>(carry);
+}
+
+limb addmul_1(limb *r, const limb *a, size_t n, limb b) {
+    double_limb carry = 0;
+    for (size_t i = 0; i < n; i++) {
+        carry += static_cast<double_limb>(a[i]) * b + r[i];
+        r[i] = static_cast<limb>(carry);
+        carry >>= LIMB_BITS;
+    }
+    return static_cast<limb>(carry);
+}
+
+limb submul_1(limb *r, const limb *a, size_t n, limb b) {
+    double_limb carry = 0;
+    for (size_t i = 0; i < n; i++) {
+        carry += static_cast<double_limb>(a[i]) * b;
+        limb lo = static_cast<limb>(carry);
+        carry >>= LIMB_BITS;
+        limb x = r[i];
+        r[i] = x - lo;
+        carry += x < lo;
+    }
+    return static_cast<limb>(carry);
+}
+
+limb divrem_1(limb *q, const limb *a, size_t n, limb d) {
+    limb rem = 0;
+    for (size_t i = n; i > 0; i--) {
+        q[i - 1] = div_2by1(rem, a[i - 1], d, rem);
+    }
+    return rem;
+}
+
+//________________________________________________________
+
+void mul_basecase(limb *r, const limb *a, size_t an, const limb *b, size_t bn) {
+    r[an] = mul_1(r, a, an, b[0]);
+    for (size_t j = 1; j < bn; j++) {
+        r[an + j] = addmul_1(r + j, a, an, b[j]);
+    }
+}
+
+// Every product a[i] * a[j] with i < j is computed once and doubled, then the squares
+// of the limbs are added on the diagonal: about half the multiplications of mul_basecase.
+void sqr_basecase(limb *r, const limb *a, size_t n) {
+    std::fill(r, r + 2 * n, 0);
+    for (size_t i = 0; i + 1 < n; i++) {
+        r[i + n] = addmul_1(r + 2 * i + 1, a + i + 1, n - i - 1, a[i]);
+    }
+    lshift(r, r, 2 * n, 1);
+    limb carry = 0;
+    for (size_t i = 0; i < n; i++) {
+        double_limb square = static_cast<double_limb>(a[i]) * a[i];
+        double_limb sum = static_cast<double_limb>(r[2 * i]) + static_cast<limb>(square) + carry;
+        r[2 * i] = static_cast<limb>(sum);
+        sum = static_cast<double_limb>(r[2 * i + 1]) + static_cast<limb>(square >> LIMB_BITS)
+              + (sum >> LIMB_BITS);
+        r[2 * i + 1] = static_cast<limb>(sum);
+        carry = static_cast<limb>(sum >> LIMB_BITS);
+    }
+}
+
+// Karatsuba takes 6m + 1 limbs per level and toom-3 16k + 16, both sum up below
+// this bound once toom-3 is past 64 limbs.
+size_t mul_scratch_size(size_t n) {
+    return 9 * n + 32;
+}
+
+namespace {
+
+// r[off, rn) += x[0, xn), limbs of x past rn are known to be zero
+void add_at(limb *r, size_t rn, size_t off, const limb *x, size_t xn) {
+    size_t len = std::min(xn, rn - off);
+    limb carry = add_n(r + off, r + off, x, len);
+    add_1(r + off + len, r + off + len, rn - off - len, carry);
+}
+
+// r[0, an) = |a - b| for an >= bn, returns true if a < b
+bool abs_diff(limb *r, const limb *a, size_t an, const limb *b, size_t bn) {
+    bool less = false;
+    if (an == bn || std::all_of(a + bn, a + an, [](limb x) { return x == 0; })) {
+        less = cmp(a, b, bn) < 0;
+    }
+    if (less) {
+        sub_n(r, b, a, bn);
+        std::fill(r + bn, r + an, 0);
+    } else {
+        sub(r, a, an, b, bn);
+    }
+    return less;
+}
+
+// a = a0 + a1 X, X = B^m with m limbs in a0 and h <= m in a1
+void mul_karatsuba(limb *r, const limb *a, const limb *b, size_t n, limb *scratch) {
+    size_t m = (n + 1) / 2, h = n - m;
+    limb *da = scratch;
+    limb *db = da + m;
+    limb *zm = db + m;
+    limb *w = zm + 2 * m;
+    limb *next = w + 2 * m + 1;
+
+    // a square needs one difference and the product of it with itself is never negative
+    bool negative = abs_diff(da, a, m, a + m, h);
+    if (a == b) {
+        db = da;
+        negative = false;
+    } else {
+        negative ^= abs_diff(db, b, m, b + m, h);
+    }
+    mul_n(r, a, b, m, next);
+    mul_n(r + 2 * m, a + m, b + m, h, next);
+    mul_n(zm, da, db, m, next);
+
+    // middle coefficient z0 + z2 - (a0 - a1)(b0 - b1)
+    w[2 * m] = add(w, r, 2 * m, r + 2 * m, 2 * h);
+    if (negative) {
+        add(w, w, 2 * m + 1, zm, 2 * m);
+    } else {
+        sub(w, w, 2 * m + 1, zm, 2 * m);
+    }
+    add_at(r, 2 * n, m, w, 2 * m + 1);
+}
+
+// p1 = a(1), p2 = a(2) and pm1 = |a(-1)|, each k + 1 limbs; returns true if a(-1) < 0
+bool toom3_evaluate(limb *p1, limb *pm1, limb *p2, const limb *a, size_t k, size_t t) {
+    const limb *a0 = a, *a1 = a + k, *a2 = a + 2 * k;
+    p1[k] = add(p1, a0, k, a2, t);
+    bool negative = false;
+    if (p1[k] == 0 && cmp(p1, a1, k) < 0) {
+        sub_n(pm1, a1, p1, k);
+        pm1[k] = 0;
+        negative = true;
+    } else {
+        pm1[k] = p1[k] - sub_n(pm1, p1, a1, k);
+    }
+    p1[k] += add_n(p1, p1, a1, k);
+    p2[k] = p1[k] + add_n(p2, p1, a1, k);
+    p2[k] += add_1(p2 + t, p2 + t, k - t, addmul_1(p2, a2, t, 3));
+    return negative;
+}
+
+// Evaluation at 0, 1, -1, 2 and infinity. Every coefficient c0..c4 of the product is
+// non-negative, so the interpolation below only ever produces non-negative intermediates:
+//   c2 = (v1 + v(-1)) / 2 - c0 - c4, c1 + c3 = (v1 - v(-1)) / 2,
+//   c1 + 4 c3 = (v2 - c0 - 4 c2 - 16 c4) / 2.
+void mul_toom3(limb *r, const limb *a, const limb *b, size_t n, limb *scratch) {
+    size_t k = (n + 2) / 3, t = n - 2 * k;
+    size_t l = k + 1, len = 2 * l;
+    limb *pa1 = scratch, *pam1 = pa1 + l, *pa2 = pam1 + l;
+    limb *pb1 = pa2 + l, *pbm1 = pb1 + l, *pb2 = pbm1 + l;
+    limb *v1 = pb2 + l, *vm1 = v1 + len, *v2 = vm1 + len;
+    limb *c2 = v2 + len, *c13 = c2 + len;
+    limb *next = c13 + len;
+
+    bool negative = toom3_evaluate(pa1, pam1, pa2, a, k, t);
+    if (a == b) {
+        pb1 = pa1;
+        pbm1 = pam1;
+        pb2 = pa2;
+        negative = false;
+    } else {
+        negative ^= toom3_evaluate(pb1, pbm1, pb2, b, k, t);
+    }
+    mul_n(v1, pa1, pb1, l, next);
+    mul_n(vm1, pam1, pbm1, l, next);
+    mul_n(v2, pa2, pb2, l, next);
+
+    limb *c0 = r, *c4 = r + 4 * k;
+    mul_n(c0, a, b, k, next);
+    mul_n(c4, a + 2 * k, b + 2 * k, t, next);
+
+    if (negative) {
+        sub_n(c2, v1, vm1, len);
+        add_n(c13, v1, vm1, len);
+    } else {
+        add_n(c2, v1, vm1, len);
+        sub_n(c13, v1, vm1, len);
+    }
+    rshift(c2, c2, len, 1);
+    rshift(c13, c13, len, 1);
+    sub(c2, c2, len, c0, 2 * k);
+    sub(c2, c2, len, c4, 2 * t);
+
+    limb *c3 = v2;
+    sub(c3, c3, len, c0, 2 * k);
+    submul_1(c3, c2, len, 4);
+    limb borrow = submul_1(c3, c4, 2 * t, 16);
+    sub_1(c3 + 2 * t, c3 + 2 * t, len - 2 * t, borrow);
+    rshift(c3, c3, len, 1);
+    sub_n(c3, c3, c13, len);
+    divrem_1(c3, c3, len, 3);
+    limb *c1 = c13;
+    sub_n(c1, c1, c3, len);
+
+    std::fill(r + 2 * k, r + 4 * k, 0);
+    add_at(r, 2 * n, k, c1, len);
+    add_at(r, 2 * n, 2 * k, c2, len);
+    add_at(r, 2 * n, 3 * k, c3, len);
+}
+
+}
+
+// operands at the same address are squared all the way down the recursion
+void mul_n(limb *r, const limb *a, const limb *b, size_t n, limb *scratch) {
+    if (a == b && n < SQR_KARATSUBA_THRESHOLD) {
+        sqr_basecase(r, a, n);
+    } else if (n < KARATSUBA_THRESHOLD) {
+        mul_basecase(r, a, n, b, n);
+    } else if (n < TOOM3_THRESHOLD) {
+        mul_karatsuba(r, a, b, n, scratch);
+    } else if (n < NTT_THRESHOLD || n > NTT_MAX_OPERAND) {
+        mul_toom3(r, a, b, n, scratch);
+    } else {
+        mul_ntt(r, a, n, b, n);
+    }
+}
+
+void mul(limb *r, const limb *a, size_t an, const limb *b, size_t bn) {
+    if (a == b && an == bn) {
+        sqr(r, a, an);
+        return;
+    }
+    if (an < bn) {
+        std::swap(a, b);
+        std::swap(an, bn);
+    }
+    if (bn < KARATSUBA_THRESHOLD) {
+        mul_basecase(r, a, an, b, bn);
+        return;
+    }
+    if (bn >= NTT_THRESHOLD && bn <= NTT_MAX_OPERAND && an + bn <= NTT_MAX_LENGTH) {
+        mul_ntt(r, a, an, b, bn);
+        return;
+    }
+    // long unbalanced operands: both halves of a times b side by side on two threads
+    if (an >= PARALLEL_THRESHOLD && an >= 2 * bn && bigint_threads() > 1) {
+        size_t h = an / 2;
+        limb_vector high(an - h + bn);
+        bigint_parallel::invoke([&] { mul(r, a, h, b, bn); },
+                                [&] { mul(high.data(), a + h, an - h, b, bn); });
+        std::copy(high.begin() + bn, high.end(), r + h + bn);
+        limb carry = add_n(r + h, r + h, high.data(), bn);
+        add_1(r + h + bn, r + h + bn, an - h, carry);
+        return;
+    }
+    limb_vector scratch(mul_scratch_size(bn));
+    mul_n(r, a, b, bn, scratch.data());
+    if (an == bn) {
+        return;
+    }
+
+    // unbalanced operands: multiply b by bn-limb blocks of a
+    limb_vector tmp(2 * bn);
+    for (size_t i = bn; i < an; i += bn) {
+        size_t len = std::min(bn, an - i);
+        if (len == bn) {
+            mul_n(tmp.data(), a + i, b, bn, scratch.data());
+        } else {
+            mul(tmp.data(), b, bn, a + i, len);
+        }
+        std::copy(tmp.begin() + bn, tmp.begin() + bn + len, r + i + bn);
+        limb carry = add_n(r + i, r + i, tmp.data(), bn);
+        add_1(r + i + bn, r + i + bn, len, carry);
+    }
+}
+
+// Below the Karatsuba threshold the rows of the product go straight into r and their
+// top limbs, which would overlap the rows above, are added in one pass at the end.
+// Larger products are formed in scratch and added.
+limb addmul(limb *r, size_t rn, const limb *a, size_t an, const limb *b, size_t bn) {
+    if (an < bn) {
+        std::swap(a, b);
+        std::swap(an, bn);
+    }
+    if (bn < KARATSUBA_THRESHOLD) {
+        limb tops[KARATSUBA_THRESHOLD];
+        for (size_t j = 0; j < bn; j++) {
+            tops[j] = addmul_1(r + j, a, an, b[j]);
+        }
+        return add(r + an, r + an, rn - an, tops, bn);
+    }
+    limb_vector product(an + bn);
+    mul(product.data(), a, an, b, bn);
+    return add(r, r, rn, product.data(), an + bn);
+}
+
+// submul_1 rows cost more than a product and a subtraction
+limb submul(limb *r, size_t rn, const limb *a, size_t an, const limb *b, size_t bn) {
+    limb_vector product(an + bn);
+    mul(product.data(), a, an, b, bn);
+    return sub(r, r, rn, product.data(), an + bn);
+}
+
+void sqr(limb *r, const limb *a, size_t n) {
+    if (n < SQR_KARATSUBA_THRESHOLD) {
+        sqr_basecase(r, a, n);
+    } else if (n >= NTT_THRESHOLD && n <= NTT_MAX_OPERAND && 2 * n <= NTT_MAX_LENGTH) {
+        mul_ntt(r, a, n, a, n);
+    } else {
+        limb_vector scratch(mul_scratch_size(n));
+        mul_n(r, a, a, n, scratch.data());
+    }
+}
+
+}
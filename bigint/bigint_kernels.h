@@ -0,0 +1,149 @@
+#ifndef BIGINT_BIGINT_KERNELS_H
+#define BIGINT_BIGINT_KERNELS_H
+
+#include "bigint_vector.h"
+#include "bigint_pool.h"
+#include <cstddef>
+#include <limits>
+
+// Low level routines over raw little-endian limb arrays holding unsigned magnitudes.
+// Unless stated otherwise the result may alias the first operand but not the second.
+namespace kernels {
+    const unsigned LIMB_BITS = std::numeric_limits<limb>::digits;
+
+    // scratch space of the kernels, pooled like the limbs of big integers
+    typedef std::vector<limb, bigint_allocator<limb> > limb_vector;
+
+    // Limits of the three-prime transform, in limbs: it works on 32-bit pieces, its length
+    // is 2^25 and every coefficient of the convolution has to stay below the product of the primes.
+    const size_t NTT_PIECES = LIMB_BITS / 32;
+    const size_t NTT_MAX_LENGTH = (size_t(1) << 25) / NTT_PIECES;
+    const size_t NTT_MAX_OPERAND = (size_t(1) << 23) / NTT_PIECES;
+
+    // Operand length in limbs from which multiplications and decimal conversions split their
+    // work between the threads of bigint_threads().
+    const size_t PARALLEL_THRESHOLD = 16384;
+
+    inline unsigned clz(uint32_t x) {
+        return __builtin_clz(x);
+    }
+
+    inline unsigned clz(uint64_t x) {
+        return __builtin_clzll(x);
+    }
+
+    inline unsigned ctz(uint32_t x) {
+        return __builtin_ctz(x);
+    }
+
+    inline unsigned ctz(uint64_t x) {
+        return __builtin_ctzll(x);
+    }
+
+    // (hi * B + lo) / d for hi < d, the remainder goes to rem. The quotient fits a limb,
+    // so with 64-bit limbs a single divq does instead of a 128-bit library division.
+    inline limb div_2by1(limb hi, limb lo, limb d, limb &rem) {
+#if BIGINT_LIMB_BITS == 64 && defined(__x86_64__)
+        limb q;
+        __asm__("divq %4" : "=a"(q), "=d"(rem) : "a"(lo), "d"(hi), "rm"(d));
+        return q;
+#else
+        double_limb num = (static_cast<double_limb>(hi) << LIMB_BITS) | lo;
+        rem = static_cast<limb>(num % d);
+        return static_cast<limb>(num / d);
+#endif
+    }
+
+    int cmp(const limb *a, const limb *b, size_t n);
+
+    // in place these stop as soon as the carry does
+    limb add_1(limb *r, const limb *a, size_t n, limb b);
+
+    limb sub_1(limb *r, const limb *a, size_t n, limb b);
+
+    // r may alias either operand of add_n and sub_n
+    limb add_n(limb *r, const limb *a, const limb *b, size_t n);
+
+    limb sub_n(limb *r, const limb *a, const limb *b, size_t n);
+
+    // an >= bn
+    limb add(limb *r, const limb *a, size_t an, const limb *b, size_t bn);
+
+    // an >= bn
+    limb sub(limb *r, const limb *a, size_t an, const limb *b, size_t bn);
+
+    limb mul_1(limb *r, const limb *a, size_t n, limb b);
+
+    limb addmul_1(limb *r, const limb *a, size_t n, limb b);
+
+    limb submul_1(limb *r, const limb *a, size_t n, limb b);
+
+    // r = op(a ^ ma, b ^ mb) ^ mr limb by limb for masks 0 or ~0, so that either operand
+    // and the result can be complemented on the way. r may alias either operand.
+    void and_n(limb *r, const limb *a, const limb *b, size_t n, limb ma, limb mb, limb mr);
+
+    void ior_n(limb *r, const limb *a, const limb *b, size_t n, limb ma, limb mb, limb mr);
+
+    void xor_n(limb *r, const limb *a, const limb *b, size_t n, limb ma, limb mb, limb mr);
+
+    // r = ~a
+    void com_n(limb *r, const limb *a, size_t n);
+
+    // 0 < cnt < limb bits, returns the bits shifted out. Besides aliasing a,
+    // r may lie above a for lshift and below it for rshift.
+    limb lshift(limb *r, const limb *a, size_t n, unsigned cnt);
+
+    limb rshift(limb *r, const limb *a, size_t n, unsigned cnt);
+
+    // returns the remainder, q may alias a
+    limb divrem_1(limb *q, const limb *a, size_t n, limb d);
+
+    void mul_basecase(limb *r, const limb *a, size_t an, const limb *b, size_t bn);
+
+    // an + bn <= NTT_MAX_LENGTH, min(an, bn) <= NTT_MAX_OPERAND
+    void mul_ntt(limb *r, const limb *a, size_t an, const limb *b, size_t bn);
+
+    // limbs of scratch that mul_n needs for operands of up to n limbs
+    size_t mul_scratch_size(size_t n);
+
+    // r[0, 2n) = a * b, r must not overlap the operands or the scratch. a == b makes it a square.
+    // Nothing is allocated below the NTT threshold.
+    void mul_n(limb *r, const limb *a, const limb *b, size_t n, limb *scratch);
+
+    // r[0, an + bn) = a * b, r must not overlap the operands. The same operand on both sides is squared.
+    void mul(limb *r, const limb *a, size_t an, const limb *b, size_t bn);
+
+    // r[0, rn) += a * b or -= a * b for rn >= an + bn, returns the carry or borrow out of r.
+    // r must not overlap the operands.
+    limb addmul(limb *r, size_t rn, const limb *a, size_t an, const limb *b, size_t bn);
+
+    limb submul(limb *r, size_t rn, const limb *a, size_t an, const limb *b, size_t bn);
+
+    // r[0, 2n) = a^2, r must not overlap a
+    void sqr_basecase(limb *r, const limb *a, size_t n);
+
+    void sqr(limb *r, const limb *a, size_t n);
+
+    // q[0, an - bn + 1) = a / b, r[0, bn) = a % b; an >= bn, b[bn - 1] != 0, no overlaps
+    void divrem(limb *q, limb *r, const limb *a, size_t an, const limb *b, size_t bn);
+
+    // limbs of scratch that barrett_reduce needs for an n-limb modulus
+    size_t barrett_scratch_size(size_t n);
+
+    // w[0, n) = w[0, 2n) mod m for m[n - 1] != 0, where m is padded with a zero limb to n + 1 limbs
+    // and inv = floor(B^2n / m) takes n + 1 limbs, less one if it does not fit.
+    // w[n] is clobbered. Nothing is allocated below the NTT threshold.
+    void barrett_reduce(limb *w, const limb *m, const limb *inv, size_t n, limb *scratch);
+
+    // g = gcd(a, b) for nonzero a and b with nonzero top limbs, returns the limbs of g.
+    // g needs min(an, bn) + 1 limbs.
+    size_t gcd(limb *g, const limb *a, size_t an, const limb *b, size_t bn);
+
+    // the same for a >= b, also s with s a = g mod b: |s| < b goes to s[0, sn), its sign to s_negative
+    size_t gcdext(limb *g, limb *s, size_t &sn, bool &s_negative, const limb *a, size_t an, const limb *b, size_t bn);
+
+    // r[0, n) = b^e mod m for odd m with m[n - 1] != 0 and e[en - 1] != 0, no overlaps
+    void powm(limb *r, const limb *b, size_t bn, const limb *e, size_t en, const limb *m, size_t n);
+}
+
+#endif //BIGINT_BIGINT_KERNELS_H
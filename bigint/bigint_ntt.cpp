@@ -0,0 +1,289 @@
+#include "bigint_kernels.h"
+#include "bigint_threads.h"
+#include <algorithm>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace kernels {
+
+namespace {
+
+__extension__ typedef unsigned __int128 u128;
+
+// Transform length in pieces from which the threads of the budget share the work, that of
+// a product of two operands of PARALLEL_THRESHOLD limbs. Shorter transforms run serially.
+const size_t NTT_PARALLEL_LENGTH = 2 * PARALLEL_THRESHOLD * NTT_PIECES;
+
+// pieces a thread gets at least of a pass
+const size_t NTT_GRAIN = 4096;
+
+// f(begin, end) over [0, count), on the threads of the budget in ranges of NTT_GRAIN and more
+template <typename F>
+void each(size_t count, F f) {
+    size_t ranges = std::max<size_t>(count / NTT_GRAIN, 1);
+    bigint_parallel::for_ranges(ranges, [&](size_t begin, size_t end) {
+        f(count * begin / ranges, count * end / ranges);
+    });
+}
+
+// Arithmetic modulo an NTT prime p < 2^31 in Montgomery form with R = 2^32.
+struct ntt_prime {
+    uint32_t p;
+    uint32_t p_inv;
+    uint32_t r2;
+    uint32_t root;
+
+    ntt_prime(uint32_t p, uint32_t g) : p(p), root(g) {
+        uint32_t inv = p;
+        for (int i = 0; i < 4; i++) {
+            inv *= 2 - p * inv;
+        }
+        p_inv = -inv;
+        r2 = static_cast<uint32_t>((static_cast<u128>(1) << 64) % p);
+    }
+
+    uint32_t reduce(uint64_t t) const {
+        uint32_t m = static_cast<uint32_t>(t) * p_inv;
+        uint32_t u = static_cast<uint32_t>((t + static_cast<uint64_t>(m) * p) >> 32);
+        return u >= p ? u - p : u;
+    }
+
+    uint32_t mul(uint32_t a, uint32_t b) const {
+        return reduce(static_cast<uint64_t>(a) * b);
+    }
+
+    uint32_t add(uint32_t a, uint32_t b) const {
+        uint32_t s = a + b;
+        return s >= p ? s - p : s;
+    }
+
+    uint32_t sub(uint32_t a, uint32_t b) const {
+        return a >= b ? a - b : a + p - b;
+    }
+
+    uint32_t to_montgomery(uint32_t a) const {
+        return mul(a % p, r2);
+    }
+
+    uint32_t from_montgomery(uint32_t a) const {
+        return reduce(a);
+    }
+
+    uint32_t pow(uint32_t a, uint64_t e) const {
+        uint32_t res = to_montgomery(1);
+        for (; e > 0; e >>= 1) {
+            if (e & 1) {
+                res = mul(res, a);
+            }
+            a = mul(a, a);
+        }
+        return res;
+    }
+
+    // roots[m + j] = w_2m^j for every power of two m < n
+    std::vector<uint32_t> roots(size_t n, bool inverse) const {
+        std::vector<uint32_t> rt(std::max<size_t>(n, 2));
+        for (size_t m = 1; m < n; m <<= 1) {
+            uint32_t w = pow(to_montgomery(root), (p - 1) / (2 * m));
+            if (inverse) {
+                w = pow(w, p - 2);
+            }
+            each(m, [&](size_t begin, size_t end) {
+                rt[m + begin] = pow(w, begin);
+                for (size_t j = begin + 1; j < end; j++) {
+                    rt[m + j] = mul(rt[m + j - 1], w);
+                }
+            });
+        }
+        return rt;
+    }
+
+    // decimation in frequency, leaves the result in bit-reversed order
+    void forward(uint32_t *a, size_t n, const std::vector<uint32_t> &rt) const {
+        // after the first pass the halves are transforms of their own
+        if (n >= 2 * NTT_GRAIN && bigint_threads() > 1) {
+            size_t m = n / 2;
+            each(m, [&](size_t begin, size_t end) {
+                for (size_t j = begin; j < end; j++) {
+                    uint32_t u = a[j], v = a[j + m];
+                    a[j] = add(u, v);
+                    a[j + m] = mul(sub(u, v), rt[m + j]);
+                }
+            });
+            bigint_parallel::invoke([&] { forward(a, m, rt); }, [&] { forward(a + m, m, rt); });
+            return;
+        }
+        for (size_t m = n / 2; m >= 1; m >>= 1) {
+            for (size_t i = 0; i < n; i += 2 * m) {
+                for (size_t j = 0; j < m; j++) {
+                    uint32_t u = a[i + j], v = a[i + j + m];
+                    a[i + j] = add(u, v);
+                    a[i + j + m] = mul(sub(u, v), rt[m + j]);
+                }
+            }
+        }
+    }
+
+    // decimation in time from bit-reversed order, not scaled by 1/n
+    void inverse(uint32_t *a, size_t n, const std::vector<uint32_t> &irt) const {
+        // the halves are transforms of their own until the last pass
+        if (n >= 2 * NTT_GRAIN && bigint_threads() > 1) {
+            size_t m = n / 2;
+            bigint_parallel::invoke([&] { inverse(a, m, irt); }, [&] { inverse(a + m, m, irt); });
+            each(m, [&](size_t begin, size_t end) {
+                for (size_t j = begin; j < end; j++) {
+                    uint32_t u = a[j], v = mul(a[j + m], irt[m + j]);
+                    a[j] = add(u, v);
+                    a[j + m] = sub(u, v);
+                }
+            });
+            return;
+        }
+        for (size_t m = 1; m < n; m <<= 1) {
+            for (size_t i = 0; i < n; i += 2 * m) {
+                for (size_t j = 0; j < m; j++) {
+                    uint32_t u = a[i + j], v = mul(a[i + j + m], irt[m + j]);
+                    a[i + j] = add(u, v);
+                    a[i + j + m] = sub(u, v);
+                }
+            }
+        }
+    }
+
+    // cyclic convolution of a and b modulo p, written to res as plain residues
+    void convolve(std::vector<uint32_t> &res, const uint32_t *a, size_t an, const uint32_t *b, size_t bn, size_t n) const {
+        res.assign(n, 0);
+        each(an, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                res[i] = to_montgomery(a[i]);
+            }
+        });
+        std::vector<uint32_t> rt = roots(n, false);
+        forward(res.data(), n, rt);
+
+        // a square takes a single forward transform
+        std::vector<uint32_t> tmp;
+        if (a != b || an != bn) {
+            tmp.assign(n, 0);
+            each(bn, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    tmp[i] = to_montgomery(b[i]);
+                }
+            });
+            forward(tmp.data(), n, rt);
+        }
+        const uint32_t *other = tmp.empty() ? res.data() : tmp.data();
+
+        uint32_t scale = pow(to_montgomery(static_cast<uint32_t>(n % p)), p - 2);
+        each(n, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                res[i] = mul(mul(res[i], other[i]), scale);
+            }
+        });
+        inverse(res.data(), n, roots(n, true));
+        each(n, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                res[i] = from_montgomery(res[i]);
+            }
+        });
+    }
+};
+
+// 15 * 2^27 + 1, 7 * 2^26 + 1 and 5 * 2^25 + 1 with their primitive roots
+const ntt_prime PRIMES[3] = {
+        ntt_prime(2013265921, 31),
+        ntt_prime(469762049, 3),
+        ntt_prime(167772161, 3)
+};
+
+// the limbs as 32-bit pieces, least significant first
+std::vector<uint32_t> split(const limb *a, size_t n) {
+    std::vector<uint32_t> res(n * NTT_PIECES);
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < NTT_PIECES; j++) {
+            res[i * NTT_PIECES + j] = static_cast<uint32_t>(a[i] >> (32 * j));
+        }
+    }
+    return res;
+}
+
+uint32_t inverse_mod(uint64_t a, uint32_t p) {
+    uint64_t res = 1, e = p - 2;
+    a %= p;
+    for (; e > 0; e >>= 1) {
+        if (e & 1) {
+            res = res * a % p;
+        }
+        a = a * a % p;
+    }
+    return static_cast<uint32_t>(res);
+}
+
+}
+
+void mul_ntt(limb *r, const limb *a, size_t an, const limb *b, size_t bn) {
+    bool square = a == b && an == bn;
+    std::vector<uint32_t> a_pieces = split(a, an), b_pieces = square ? std::vector<uint32_t>() : split(b, bn);
+    const std::vector<uint32_t> &b_ref = square ? a_pieces : b_pieces;
+    size_t len = (an + bn) * NTT_PIECES;
+    size_t n = 1;
+    while (n < len - 1) {
+        n <<= 1;
+    }
+    bigint_thread_scope threads(n < NTT_PARALLEL_LENGTH ? 1 : bigint_threads());
+    std::vector<uint32_t> res[3];
+    // one prime per thread once there are enough of them, otherwise they share the passes
+    auto convolve = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            PRIMES[i].convolve(res[i], a_pieces.data(), a_pieces.size(), b_ref.data(), b_ref.size(), n);
+        }
+    };
+    if (bigint_threads() >= 3) {
+        bigint_parallel::for_ranges(3, convolve);
+    } else {
+        convolve(0, 3);
+    }
+
+    // Garner: x = v0 + v1 p0 + v2 p0 p1 < p0 p1 p2
+    const uint64_t p0 = PRIMES[0].p, p1 = PRIMES[1].p, p2 = PRIMES[2].p;
+    const uint64_t p0_inv_p1 = inverse_mod(p0, p1);
+    const uint64_t p0_inv_p2 = inverse_mod(p0, p2);
+    const uint64_t p1_inv_p2 = inverse_mod(p1, p2);
+    const u128 p0p1 = static_cast<u128>(p0) * p1;
+
+    // every range of limbs carries into the next one, those carries are added afterwards
+    size_t rn = an + bn;
+    std::vector<std::pair<size_t, u128> > carries;
+    std::mutex carries_mutex;
+    each(rn, [&](size_t begin, size_t end) {
+        u128 carry = 0;
+        std::fill(r + begin, r + end, 0);
+        for (size_t i = begin * NTT_PIECES; i < end * NTT_PIECES; i++) {
+            if (i + 1 < len) {
+                uint64_t v0 = res[0][i];
+                uint64_t v1 = (res[1][i] + p1 - v0 % p1) * p0_inv_p1 % p1;
+                uint64_t v2 = (res[2][i] + p2 - v0 % p2) * p0_inv_p2 % p2;
+                v2 = (v2 + p2 - v1 % p2) * p1_inv_p2 % p2;
+                carry += v0 + static_cast<u128>(v1) * p0 + v2 * p0p1;
+            }
+            r[i / NTT_PIECES] |= static_cast<limb>(static_cast<uint32_t>(carry)) << (32 * (i % NTT_PIECES));
+            carry >>= 32;
+        }
+        if (carry != 0 && end < rn) {
+            std::lock_guard<std::mutex> lock(carries_mutex);
+            carries.push_back(std::make_pair(end, carry));
+        }
+    });
+    for (size_t i = 0; i < carries.size(); i++) {
+        const size_t CARRY_LIMBS = sizeof(u128) / sizeof(limb);
+        limb c[CARRY_LIMBS];
+        for (size_t j = 0; j < CARRY_LIMBS; j++) {
+            c[j] = static_cast<limb>(carries[i].second >> (LIMB_BITS * j));
+        }
+        size_t pos = carries[i].first;
+        add(r + pos, r + pos, rn - pos, c, std::min(CARRY_LIMBS, rn - pos));
+    }
+}
+
+}
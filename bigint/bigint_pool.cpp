@@ -0,0 +1,143 @@
+#include "bigint_pool.h"
+#include <new>
+
+namespace bigint_pool {
+
+namespace {
+
+void *(*hook_allocate)(size_t) = nullptr;
+void (*hook_release)(void *, size_t) = nullptr;
+
+#ifndef BIGINT_NO_POOL
+
+// Blocks of 64 bytes, then four classes for every power of two up to 2^25 bytes: the
+// sizes in (2^(b-1), 2^b] are rounded up to a multiple of 2^(b-3). Larger blocks come
+// from the system directly.
+const unsigned MIN_CLASS = 6;
+const unsigned STEPS = 4;
+const unsigned MAX_CLASS = 25;
+const unsigned CLASSES = 1 + (MAX_CLASS - MIN_CLASS) * STEPS;
+
+struct free_block {
+    free_block *next;
+};
+
+// Plain data without a destructor, so that it stays usable for the blocks released
+// after the cleanup of the thread has run, such as those of static big integers.
+struct thread_pool {
+    free_block *lists[CLASSES];
+    size_t bytes;
+    unsigned scopes;
+    bool closed;
+};
+
+thread_local thread_pool pool;
+
+struct thread_cleanup {
+    ~thread_cleanup();
+};
+
+// constructed by the first release of a thread to give its blocks back at its exit
+thread_local thread_cleanup cleanup;
+
+inline unsigned size_class(size_t size) {
+    if (size <= (size_t(1) << MIN_CLASS)) {
+        return 0;
+    }
+    size_t s = size - 1;
+    unsigned bits = static_cast<unsigned>(sizeof(unsigned long long) * 8 - __builtin_clzll(s));
+    unsigned step = static_cast<unsigned>(s >> (bits - 3)) & (STEPS - 1);
+    return 1 + (bits - MIN_CLASS - 1) * STEPS + step;
+}
+
+inline size_t class_size(unsigned c) {
+    if (c == 0) {
+        return size_t(1) << MIN_CLASS;
+    }
+    unsigned bits = MIN_CLASS + 1 + (c - 1) / STEPS;
+    return (size_t(1) << (bits - 1)) + (size_t((c - 1) % STEPS + 1) << (bits - 3));
+}
+
+// frees the largest blocks first until at most limit bytes are left
+void trim(size_t limit) {
+    for (unsigned c = CLASSES; c-- > 0 && pool.bytes > limit;) {
+        while (pool.lists[c] && pool.bytes > limit) {
+            free_block *b = pool.lists[c];
+            pool.lists[c] = b->next;
+            pool.bytes -= class_size(c);
+            ::operator delete(b);
+        }
+    }
+}
+
+thread_cleanup::~thread_cleanup() {
+    trim(0);
+    pool.closed = true;
+}
+
+#endif
+
+}
+
+void *allocate(size_t &size) {
+    if (hook_allocate) {
+        return hook_allocate(size);
+    }
+#ifndef BIGINT_NO_POOL
+    unsigned c = size_class(size);
+    if (c >= CLASSES) {
+        return ::operator new(size);
+    }
+    size = class_size(c);
+    free_block *b = pool.lists[c];
+    if (b) {
+        pool.lists[c] = b->next;
+        pool.bytes -= size;
+        return b;
+    }
+#endif
+    return ::operator new(size);
+}
+
+void release(void *block, size_t size) {
+    if (hook_release) {
+        hook_release(block, size);
+        return;
+    }
+#ifndef BIGINT_NO_POOL
+    unsigned c = size_class(size);
+    size = class_size(c);
+    if (c >= CLASSES || pool.closed || (pool.scopes == 0 && pool.bytes + size > BIGINT_POOL_BYTES)) {
+        ::operator delete(block);
+        return;
+    }
+    (void) &cleanup;
+    free_block *b = static_cast<free_block *>(block);
+    b->next = pool.lists[c];
+    pool.lists[c] = b;
+    pool.bytes += size;
+#else
+    ::operator delete(block);
+#endif
+}
+
+}
+
+void bigint_set_allocator(void *(*allocate)(size_t size), void (*release)(void *block, size_t size)) {
+    bigint_pool::hook_allocate = allocate;
+    bigint_pool::hook_release = allocate ? release : nullptr;
+}
+
+bigint_scratch_scope::bigint_scratch_scope() {
+#ifndef BIGINT_NO_POOL
+    bigint_pool::pool.scopes++;
+#endif
+}
+
+bigint_scratch_scope::~bigint_scratch_scope() {
+#ifndef BIGINT_NO_POOL
+    if (--bigint_pool::pool.scopes == 0) {
+        bigint_pool::trim(BIGINT_POOL_BYTES);
+    }
+#endif
+}
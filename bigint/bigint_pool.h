@@ -0,0 +1,76 @@
+#ifndef BIGINT_BIGINT_POOL_H
+#define BIGINT_BIGINT_POOL_H
+
+#include <cstddef>
+#include <vector>
+
+// Bytes of free blocks every thread keeps for reuse outside of a bigint_scratch_scope.
+#ifndef BIGINT_POOL_BYTES
+#define BIGINT_POOL_BYTES (size_t(1) << 20)
+#endif
+
+// Heap memory of the limbs, served from free lists of the calling thread in size classes
+// of four per power of two. Short-lived temporaries of the arithmetic then reuse each
+// other's blocks instead of going through malloc and its locks, at the price of up to a
+// quarter of a block rounded away, which long-lived values keep as well. A block may be
+// released by another thread than the one that allocated it, it joins the pool of the
+// releasing thread. Defining BIGINT_NO_POOL serves every block from the system instead.
+namespace bigint_pool {
+    // a block of at least size bytes, size is raised to what the block actually holds
+    void *allocate(size_t &size);
+
+    // size is the requested or the raised size of the block
+    void release(void *block, size_t size);
+}
+
+// Replaces the pool with the given functions, release gets the size passed to allocate.
+// They have to be installed before the first block is allocated and stay for as long as
+// any block lives; null functions leave the pool in place. Installing them is not
+// thread-safe: no other thread may use big integers meanwhile.
+void bigint_set_allocator(void *(*allocate)(size_t size), void (*release)(void *block, size_t size));
+
+// While a scope is alive on a thread its pool keeps every block released to it, so a
+// computation that runs inside allocates each size only once. Leaving the outermost
+// scope hands what exceeds BIGINT_POOL_BYTES back to the system. Scopes may nest.
+class bigint_scratch_scope {
+public:
+    bigint_scratch_scope();
+
+    ~bigint_scratch_scope();
+
+    bigint_scratch_scope(bigint_scratch_scope const &) = delete;
+
+    bigint_scratch_scope &operator=(bigint_scratch_scope const &) = delete;
+};
+
+// std::allocator replacement that takes its memory from the pool
+template <typename T>
+struct bigint_allocator {
+    typedef T value_type;
+
+    bigint_allocator() {}
+
+    template <typename U>
+    bigint_allocator(bigint_allocator<U> const &) {}
+
+    T *allocate(size_t n) {
+        size_t size = n * sizeof(T);
+        return static_cast<T *>(bigint_pool::allocate(size));
+    }
+
+    void deallocate(T *p, size_t n) {
+        bigint_pool::release(p, n * sizeof(T));
+    }
+};
+
+template <typename T, typename U>
+bool operator==(bigint_allocator<T> const &, bigint_allocator<U> const &) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(bigint_allocator<T> const &, bigint_allocator<U> const &) {
+    return false;
+}
+
+#endif //BIGINT_BIGINT_POOL_H
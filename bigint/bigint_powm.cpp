@@ -0,0 +1,134 @@
+#include "bigint_kernels.h"
+#include <algorithm>
+#include <vector>
+
+namespace kernels {
+
+namespace {
+
+// -1 / m0 mod B for odd m0. m0 is its own inverse mod 8 and every Newton step
+// doubles the number of correct low bits.
+limb neg_inverse(limb m0) {
+    limb inv = m0;
+    for (unsigned bits = 3; bits < LIMB_BITS; bits *= 2) {
+        inv *= static_cast<limb>(2 - m0 * inv);
+    }
+    return static_cast<limb>(0 - inv);
+}
+
+// Montgomery arithmetic modulo m: residues are kept as x * B^n mod m, so that a product
+// is reduced by n multiply-adds of m that clear its low limbs instead of by a division.
+struct montgomery {
+    const limb *m;
+    size_t n;
+    limb minv;
+    limb_vector t;
+
+    montgomery(const limb *m, size_t n) : m(m), n(n), minv(neg_inverse(m[0])), t(2 * n) {}
+
+    // r = t / B^n mod m for t < m * B^n. The carry out of every row is parked in the limb
+    // the row has just cleared and all of them are added at once in the end.
+    void redc(limb *r) {
+        limb *x = t.data();
+        for (size_t i = 0; i < n; i++) {
+            limb u = x[i] * minv;
+            x[i] = addmul_1(x + i, m, n, u);
+        }
+        limb carry = add_n(r, x + n, x, n);
+        if (carry || cmp(r, m, n) >= 0) {
+            sub_n(r, r, m, n);
+        }
+    }
+
+    // r may alias the operands
+    void mul(limb *r, const limb *a, const limb *b) {
+        kernels::mul(t.data(), a, n, b, n);
+        redc(r);
+    }
+
+    void sqr(limb *r, const limb *a) {
+        kernels::sqr(t.data(), a, n);
+        redc(r);
+    }
+
+    // r = a * B^n mod m
+    void to_montgomery(limb *r, const limb *a, size_t an) {
+        limb_vector x(an + n);
+        limb_vector q(an + 1);
+        std::copy(a, a + an, x.begin() + n);
+        divrem(q.data(), r, x.data(), an + n, m, n);
+    }
+
+    void from_montgomery(limb *r, const limb *a) {
+        std::copy(a, a + n, t.begin());
+        std::fill(t.begin() + n, t.end(), 0);
+        redc(r);
+    }
+};
+
+inline limb bit(const limb *e, size_t i) {
+    return (e[i / LIMB_BITS] >> (i % LIMB_BITS)) & 1;
+}
+
+// Window width that minimizes the precomputed odd powers plus one multiplication per window.
+unsigned window_bits(size_t ebits) {
+    static const size_t limits[] = {7, 25, 81, 241, 673, 1793};
+    unsigned k = 1;
+    while (k <= 6 && ebits > limits[k - 1]) {
+        k++;
+    }
+    return k;
+}
+
+}
+
+// Left-to-right sliding window: a zero bit costs a squaring, and a window of up to k bits
+// that starts and ends with a one costs its squarings and a multiplication by one of
+// the odd powers b, b^3, ..., b^(2^k - 1).
+void powm(limb *r, const limb *b, size_t bn, const limb *e, size_t en, const limb *m, size_t n) {
+    montgomery mont(m, n);
+    size_t ebits = en * LIMB_BITS - clz(e[en - 1]);
+    unsigned k = window_bits(ebits);
+
+    limb_vector table(n << (k - 1));
+    mont.to_montgomery(table.data(), b, bn);
+    if (k > 1) {
+        limb_vector square(n);
+        mont.sqr(square.data(), table.data());
+        for (size_t i = 1; i < (size_t(1) << (k - 1)); i++) {
+            mont.mul(&table[i * n], &table[(i - 1) * n], square.data());
+        }
+    }
+
+    // the top bit is set, so the first window initializes r
+    bool first = true;
+    for (size_t i = ebits; i > 0;) {
+        if (!bit(e, i - 1)) {
+            mont.sqr(r, r);
+            i--;
+            continue;
+        }
+        size_t j = i > k ? i - k : 0;
+        while (!bit(e, j)) {
+            j++;
+        }
+        size_t w = 0;
+        for (size_t l = i; l-- > j;) {
+            w = (w << 1) | bit(e, l);
+        }
+        const limb *power = &table[(w >> 1) * n];
+        if (first) {
+            std::copy(power, power + n, r);
+            first = false;
+        } else {
+            for (size_t l = j; l < i; l++) {
+                mont.sqr(r, r);
+            }
+            mont.mul(r, r, power);
+        }
+        i = j;
+    }
+    mont.from_montgomery(r, r);
+}
+
+}
@@ -0,0 +1,31 @@
+#include "bigint_threads.h"
+#include <atomic>
+
+namespace {
+
+std::atomic<unsigned> global_threads(1);
+
+// zero while no scope is alive on the thread
+thread_local unsigned scoped_threads = 0;
+
+unsigned resolve(unsigned threads) {
+    return threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+}
+
+void bigint_set_threads(unsigned threads) {
+    global_threads.store(resolve(threads), std::memory_order_relaxed);
+}
+
+unsigned bigint_threads() {
+    return scoped_threads != 0 ? scoped_threads : global_threads.load(std::memory_order_relaxed);
+}
+
+bigint_thread_scope::bigint_thread_scope(unsigned threads) : previous(scoped_threads) {
+    scoped_threads = resolve(threads);
+}
+
+bigint_thread_scope::~bigint_thread_scope() {
+    scoped_threads = previous;
+}
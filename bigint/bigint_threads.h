@@ -0,0 +1,95 @@
+#ifndef BIGINT_BIGINT_THREADS_H
+#define BIGINT_BIGINT_THREADS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// Number of threads, the calling one included, that a single operation may spread its
+// work over. Only multiplications, squares and decimal conversions of operands of 16384
+// limbs (kernels::PARALLEL_THRESHOLD) and more make use of it. The budget is 1 unless
+// set, 0 stands for std::thread::hardware_concurrency().
+void bigint_set_threads(unsigned threads);
+
+// the budget of the innermost bigint_thread_scope of the calling thread, or the global one
+unsigned bigint_threads();
+
+// Sets the budget of the operations that the calling thread runs while the scope is alive,
+// in place of the global one. Scopes may nest.
+class bigint_thread_scope {
+public:
+    explicit bigint_thread_scope(unsigned threads);
+
+    ~bigint_thread_scope();
+
+    bigint_thread_scope(bigint_thread_scope const &) = delete;
+
+    bigint_thread_scope &operator=(bigint_thread_scope const &) = delete;
+
+private:
+    unsigned previous;
+};
+
+// Fork-join over the budget of the calling thread. Threads are started for every split
+// and joined before it returns, the operations worth splitting take far longer than that.
+namespace bigint_parallel {
+    // Calls f(begin, end) on contiguous ranges covering [0, count), at most one per thread
+    // of the budget and the first on the calling thread. Every call runs with its share of
+    // the budget, an exception thrown by one of them is rethrown after all have finished.
+    template <typename F>
+    void for_ranges(size_t count, F f) {
+        unsigned threads = bigint_threads();
+        size_t parts = std::min<size_t>(threads, count);
+        if (parts <= 1) {
+            f(size_t(0), count);
+            return;
+        }
+        std::vector<std::exception_ptr> errors(parts);
+        auto run = [&](size_t i) {
+            bigint_thread_scope scope(static_cast<unsigned>(threads / parts + (i < threads % parts)));
+            try {
+                f(count * i / parts, count * (i + 1) / parts);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        };
+        std::vector<std::thread> workers;
+        workers.reserve(parts - 1);
+        for (size_t i = 1; i < parts; i++) {
+            try {
+                workers.emplace_back(run, i);
+            } catch (std::system_error const &) {
+                // no thread to be had, the part runs here
+                run(i);
+            }
+        }
+        run(0);
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+        for (std::exception_ptr const &error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    // f() and g(), on two threads if the budget allows
+    template <typename F, typename G>
+    void invoke(F f, G g) {
+        for_ranges(2, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                if (i == 0) {
+                    f();
+                } else {
+                    g();
+                }
+            }
+        });
+    }
+}
+
+#endif //BIGINT_BIGINT_THREADS_H
@@ -1,193 +1,233 @@
 #include "bigint_vector.h"
-#include <memory>
+#include "bigint_pool.h"
+#include <new>
+#include <utility>
 #include <algorithm>
 #include <cassert>
 
-bigint_vector::bigint_vector(int curlen, int value) {
-    if (curlen > 1) {
-        elements = std::make_shared<std::vector<uint>>(curlen, value);
-    } else if (curlen == 1) {
-        element = value;
-    }
-    len = curlen;
+namespace {
+
+#ifdef BIGINT_SINGLE_THREADED
+inline void add_ref(size_t &refs) {
+    ++refs;
 }
 
-uint bigint_vector::size() const {
-    return len;
+inline bool remove_ref(size_t &refs) {
+    return --refs == 0;
 }
 
-bigint_vector::bigint_vector(int curlen) {
-    if (curlen > 1) {
-        elements = std::make_shared<std::vector<uint>>(curlen);
-    }
-    len = curlen;
+inline bool shared(size_t const &refs) {
+    return refs != 1;
+}
+#else
+inline void add_ref(std::atomic<size_t> &refs) {
+    refs.fetch_add(1, std::memory_order_relaxed);
 }
 
-uint bigint_vector::operator[](size_t ind) const {
-    if (small()) {
-        return element;
-    }
-    return elements->operator[](ind);
+inline bool remove_ref(std::atomic<size_t> &refs) {
+    return refs.fetch_sub(1, std::memory_order_acq_rel) == 1;
 }
 
-uint &bigint_vector::operator[](size_t ind) {
-    if (small()) {
-        return element;
-    }
-    unique();
-    return elements->operator[](ind);
+inline bool shared(std::atomic<size_t> const &refs) {
+    return refs.load(std::memory_order_acquire) != 1;
 }
+#endif
 
-uint bigint_vector::back() const {
-    if (small()) {
-        return element;
+}
+
+// the block from the pool may be larger than asked for, its rest is room to grow
+bigint_vector::buffer *bigint_vector::allocate(size_t capacity) {
+    size_t size = sizeof(buffer) + capacity * sizeof(limb);
+    void *memory = bigint_pool::allocate(size);
+    return new (memory) buffer((size - sizeof(buffer)) / sizeof(limb));
+}
+
+void bigint_vector::release(buffer *b) {
+    if (remove_ref(b->refs)) {
+        size_t size = sizeof(buffer) + b->capacity * sizeof(limb);
+        b->~buffer();
+        bigint_pool::release(b, size);
     }
-    return elements->back();
 }
 
-uint &bigint_vector::back() {
+bigint_vector::bigint_vector(int curlen, limb value) {
+    len = curlen;
     if (small()) {
-        return element;
+        std::fill(inline_limbs, inline_limbs + len, value);
+    } else {
+        heap = allocate(len);
+        std::fill(heap->limbs(), heap->limbs() + len, value);
     }
-    unique();
-    return elements->back();
+}
+
+uint bigint_vector::size() const {
+    return len;
+}
+
+bigint_vector::bigint_vector(int curlen) : bigint_vector(curlen, 0) {}
+
+limb bigint_vector::operator[](size_t ind) const {
+    return data()[ind];
+}
+
+limb &bigint_vector::operator[](size_t ind) {
+    return data()[ind];
+}
+
+limb bigint_vector::back() const {
+    return data()[len - 1];
+}
+
+limb &bigint_vector::back() {
+    return data()[len - 1];
 }
 
 void bigint_vector::resize(size_t curlen) {
-    if (small()) {
-        if (curlen > 1) {
-            elements = std::make_shared<std::vector<uint>>(curlen, element);
-        }
+    if (curlen <= len) {
+        shrink(curlen);
+        return;
+    } else if (curlen <= INLINE_CAPACITY) {
+        std::fill(inline_limbs + len, inline_limbs + curlen, 0);
     } else {
-        if (curlen > 1) {
-            unique();
-            elements->resize(curlen);
-        } else if (curlen == 1) {
-            uint tmp = *elements->begin();
-            elements.reset();
-            element = tmp;
+        if (small()) {
+            buffer *b = allocate(std::max(curlen, 2 * INLINE_CAPACITY));
+            std::copy(inline_limbs, inline_limbs + len, b->limbs());
+            heap = b;
+        } else if (curlen > heap->capacity) {
+            reallocate(std::max(curlen, 2 * heap->capacity));
         } else {
-            elements.reset();
+            unique();
         }
+        std::fill(heap->limbs() + len, heap->limbs() + curlen, 0);
     }
     len = curlen;
 }
 
-void bigint_vector::push_back(uint value) {
-    if (len == 0) {
-        element = value;
-    } else if (len == 1) {
-        elements = std::make_shared<std::vector<uint>>(1, element);
-        elements->push_back(value);
-    } else {
-        unique();
-        elements->push_back(value);
+// a shared buffer may stay shared, only its prefix is in use
+void bigint_vector::shrink(size_t curlen) {
+    if (!small() && curlen <= INLINE_CAPACITY) {
+        buffer *b = heap;
+        std::copy(b->limbs(), b->limbs() + curlen, inline_limbs);
+        release(b);
     }
-    len++;
+    len = curlen;
+}
+
+void bigint_vector::push_back(limb value) {
+    resize(len + 1);
+    data()[len - 1] = value;
 }
 
 void bigint_vector::reverse() {
-    if (!small()) {
-        std::reverse(elements->begin(), elements->end());
-    }
+    limb *d = data();
+    std::reverse(d, d + len);
 }
 
 void bigint_vector::pop_back() {
-    if (len > 2) {
-        unique();
-        elements->pop_back();
-    } else if (len == 2) {
-        uint tmp = *elements->begin();
-        elements.reset();
-        element = tmp;
-    } else {
-        element = 0;
-    }
-    len--;
+    shrink(len - 1);
 }
 
 void bigint_vector::insert_begin(uint cnt) {
-    if (small()) {
-        if (cnt > 0) {
-            uint tmp = element;
-            elements = std::make_shared<std::vector<uint>>(cnt + 1);
-            elements->back() = tmp;
-        }
-    } else {
-        unique();
-        elements->insert(elements->begin(), cnt, 0);
-    }
-    len += cnt;
+    size_t old_len = len;
+    resize(len + cnt);
+    limb *d = data();
+    std::copy_backward(d, d + old_len, d + len);
+    std::fill(d, d + cnt, 0);
 }
 
 void bigint_vector::erase_begin(uint cnt) {
-    if (!small()) {
-        if (len - cnt > 1) {
-            unique();
-            elements->erase(elements->begin(), elements->begin() + cnt);
-        } else {
-            element = *elements->begin();
-            elements.reset();
-        }
-    }
-    len -= cnt;
+    limb *d = data();
+    std::copy(d + cnt, d + len, d);
+    shrink(len - cnt);
 }
 
 bool operator==(bigint_vector const &a, bigint_vector const &b) {
-    if (a.small() != b.small()) {
-        return false;
-    }
-    if (a.small()) {
-        return a.element == b.element;
-    }
-    return *a.elements == *b.elements;
+    return a.len == b.len && std::equal(a.data(), a.data() + a.len, b.data());
 }
 
 void bigint_vector::unique() {
-    if (!elements.unique()) {
-        elements = std::make_shared<std::vector<uint>>(*elements);
+    if (shared(heap->refs)) {
+        reallocate(heap->capacity);
     }
 }
 
+// moves the heap limbs to a private buffer of the given capacity
+void bigint_vector::reallocate(size_t capacity) {
+    buffer *b = allocate(capacity);
+    std::copy(heap->limbs(), heap->limbs() + len, b->limbs());
+    release(heap);
+    heap = b;
+}
+
 bool bigint_vector::small() const {
-    return len <= 1;
+    return len <= INLINE_CAPACITY;
 }
 
 bigint_vector &bigint_vector::operator=(bigint_vector const &other) {
+    if (this == &other) {
+        return *this;
+    }
+    if (!other.small()) {
+        add_ref(other.heap->refs);
+    }
+    if (!small()) {
+        release(heap);
+    }
+    if (other.small()) {
+        std::copy(other.inline_limbs, other.inline_limbs + other.len, inline_limbs);
+    } else {
+        heap = other.heap;
+    }
+    len = other.len;
+    return *this;
+}
+
+bigint_vector &bigint_vector::operator=(bigint_vector &&other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
     if (!small()) {
-        elements.reset();
+        release(heap);
     }
     if (other.small()) {
-        element = other.element;
+        std::copy(other.inline_limbs, other.inline_limbs + other.len, inline_limbs);
     } else {
-        elements = other.elements;
+        heap = other.heap;
     }
     len = other.len;
+    other.len = 0;
     return *this;
 }
 
 bigint_vector::bigint_vector() {
     len = 0;
-    element = 0;
+}
+
+bigint_vector::bigint_vector(bigint_vector const &other) : len(0) {
+    *this = other;
+}
+
+bigint_vector::bigint_vector(bigint_vector &&other) noexcept : len(0) {
+    *this = std::move(other);
 }
 
 bigint_vector::~bigint_vector() {
     if (!small()) {
-        elements.reset();
+        release(heap);
     }
 }
 
-uint* bigint_vector::data() {
+limb *bigint_vector::data() {
     if (small()) {
-        return &element;
+        return inline_limbs;
     }
     unique();
-    return elements->data();
+    return heap->limbs();
 }
 
-const uint* bigint_vector::data() const {
+const limb *bigint_vector::data() const {
     if (small()) {
-        return const_cast<uint*>(&element);
+        return inline_limbs;
     }
-    return elements->data();
+    return heap->limbs();
 }
@@ -1,35 +1,69 @@
 #ifndef BIGINT_BIGINT_VECTOR_H
 #define BIGINT_BIGINT_VECTOR_H
 
-#include <memory>
-#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 
 typedef uint32_t uint;
 typedef uint64_t ull;
 
+// Width of a limb of the magnitude, 32 or 64 bits. Products of two limbs are
+// held in double_limb, so 64-bit limbs need unsigned __int128.
+#ifndef BIGINT_LIMB_BITS
+#define BIGINT_LIMB_BITS 32
+#endif
+
+#if BIGINT_LIMB_BITS == 64
+typedef uint64_t limb;
+__extension__ typedef unsigned __int128 double_limb;
+#elif BIGINT_LIMB_BITS == 32
+typedef uint32_t limb;
+typedef uint64_t double_limb;
+#else
+#error "BIGINT_LIMB_BITS must be 32 or 64"
+#endif
+
+// Number of limbs kept inside the vector itself, longer ones share a heap buffer.
+#ifndef BIGINT_INLINE_LIMBS
+#define BIGINT_INLINE_LIMBS 4
+#endif
+
+// Reference counter of the shared heap buffers. Builds that never share big integers
+// between threads may define BIGINT_SINGLE_THREADED to count without atomics.
+#ifdef BIGINT_SINGLE_THREADED
+typedef size_t bigint_refcount;
+#else
+typedef std::atomic<size_t> bigint_refcount;
+#endif
+
 class bigint_vector {
 public:
-    explicit bigint_vector(int curlen, int value);
+    explicit bigint_vector(int curlen, limb value);
 
     explicit bigint_vector(int curlen);
 
     bigint_vector();
 
+    bigint_vector(bigint_vector const &other);
+
+    bigint_vector(bigint_vector &&other) noexcept;
+
     ~bigint_vector();
 
     uint size() const;
 
-    uint operator[](size_t ind) const;
+    limb operator[](size_t ind) const;
 
-    uint &operator[](size_t ind);
+    limb &operator[](size_t ind);
 
-    uint back() const;
+    limb back() const;
 
-    uint &back();
+    limb &back();
 
     void resize(size_t curlen);
 
-    void push_back(uint value);
+    void push_back(limb value);
 
     void reverse();
 
@@ -43,20 +77,48 @@ public:
 
     bigint_vector& operator=(bigint_vector const &other);
 
-    const uint* data() const;
+    // the moved-from vector is left empty
+    bigint_vector& operator=(bigint_vector &&other) noexcept;
 
-    uint* data();
+    const limb* data() const;
+
+    limb* data();
 
 private:
+    static const size_t INLINE_CAPACITY = BIGINT_INLINE_LIMBS;
+    static_assert(INLINE_CAPACITY >= 1, "at least one limb has to be stored inline");
+
+    // header of a single allocation, the limbs follow it
+    struct buffer {
+        bigint_refcount refs;
+        size_t capacity;
+
+        explicit buffer(size_t capacity) : refs(1), capacity(capacity) {}
+
+        limb *limbs() {
+            return reinterpret_cast<limb *>(this + 1);
+        }
+    };
+
     size_t len;
 
-    uint element;
-    std::shared_ptr<std::vector<uint>> elements;
+    union {
+        limb inline_limbs[INLINE_CAPACITY];
+        buffer *heap;
+    };
+
+    static buffer *allocate(size_t capacity);
+
+    static void release(buffer *b);
 
     bool small() const;
 
     void unique();
 
+    void reallocate(size_t capacity);
+
+    void shrink(size_t curlen);
+
 };
 
 bool operator==(bigint_vector const &a, bigint_vector const &b);